@@ -0,0 +1,310 @@
+// end to end search benchmarks: a fixed set of search problems, with the solution depth, node count, throughput
+// and peak memory of each, compared against a baseline file
+//
+//   CpplesteBenchmark [problem...]                            run the problems (all of them if none are given)
+//   CpplesteBenchmark --baseline file [--tolerance t] [problem...]  also compare against the baseline, exits with 1
+//                                                             if the depth, solutions or nodes of a problem changed.
+//                                                             with --tolerance, also if its nodes/s dropped by more
+//                                                             than t (throughput is only comparable on the machine
+//                                                             that recorded the baseline, and when it's idle)
+//   CpplesteBenchmark --baseline file --record [problem...]   write the results to the baseline instead
+//                                                             (peak memory is the process', run one problem at a time)
+//   CpplesteBenchmark --list                                  print the problem names
+
+#include "Searcheline.h"
+#include "ThreadedSearcheline.h"
+#include "CelesteUtils.h"
+#include "Carts/Celeste.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// the problem of ExampleSearcheline100: the end of 100m, with only {r, r + z, r + x, u + x, u + r + x}
+void init_100m(PICO8<Celeste> &p8) {
+    utils::load_room(p8, 0);
+    utils::supress_object<Celeste::fake_wall>(p8);
+    utils::skip_player_spawn(p8);
+    for (auto a: {18, 2, 2, 2, 2, 2, 2, 2, 2, 2, 34, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}) {
+        p8.set_btn_state(a);
+        p8.step();
+    }
+}
+
+vector<int> actions_100m(bool can_jump, bool can_dash) {
+    vector<int> actions{0b000010};
+    if (can_jump) {
+        actions.push_back(0b010010);
+    }
+    if (can_dash) {
+        actions.insert(actions.end(), {0b100010, 0b100100, 0b100110});
+    }
+    return actions;
+}
+
+class Search100 : public Searcheline<> {
+    void init_state() override {
+        init_100m(p8);
+    }
+    vector<int> allowable_actions(const State &state, Celeste::player &player, bool h_movement, bool can_jump,
+                                  bool can_dash) override {
+        return actions_100m(can_jump, can_dash);
+    }
+};
+
+class Worker100 : public SearchelineWorker<> {
+    template<typename, typename> friend class ThreadedSearcheline;
+    using SearchelineWorker<>::SearchelineWorker;
+
+    void init_state() override {
+        init_100m(p8);
+    }
+    vector<int> allowable_actions(const State &state, Celeste::player &player, bool h_movement, bool can_jump,
+                                  bool can_dash) override {
+        return actions_100m(can_jump, can_dash);
+    }
+};
+
+// the problem of ExampleSearcheline2100
+class Search2100 : public Searcheline<> {
+    void init_state() override {
+        utils::load_room(p8, 20);
+        utils::supress_object<Celeste::balloon>(p8);
+        utils::skip_player_spawn(p8);
+    }
+    vector<int> allowable_actions(const State &state, Celeste::player &player, bool h_movement, bool can_jump,
+                                  bool can_dash) override {
+        vector<int> actions{0b000010};
+        if (can_jump) {
+            actions.push_back(0b010010);
+        }
+        if (can_dash) {
+            actions.push_back(0b100110);
+        }
+        return actions;
+    }
+    int exit_heuristic(const Celeste::player &player) override {
+        return ceil((player.y + 4) / 4);
+    }
+};
+
+// every input sequence from the spawn of a room up to a fixed depth, mostly measures the emulator
+template<int level>
+class SearchRoom : public Searcheline<> {
+    void init_state() override {
+        utils::load_room(p8, level);
+        utils::skip_player_spawn(p8);
+    }
+    double h_cost(const State &state) override {
+        return is_rip(state) ? HUGE_VAL : 0;
+    }
+};
+
+struct Result {
+    int depth = -1; // length of the shortest solution, -1 if there's none
+    long long solutions = 0;
+    long long nodes = 0;
+    double seconds = 0;
+    long peak_rss = 0; // kB, of the whole process
+    double nodes_per_second() const {
+        return seconds > 0 ? nodes / seconds : 0;
+    }
+};
+
+long peak_rss_kb() {
+#if defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+#elif defined(__unix__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+// searches are run at least min_runs times, and until they took min_seconds in total. they're timed by their
+// fastest run, which is far less noisy than any single one
+const int min_runs = 3;
+const double min_seconds = 1;
+
+template<typename searchType>
+Result measure(searchType &s, const function<void()> &search, const function<long long()> &nodes) {
+    Result r;
+    s.set_quiet();
+    s.set_verbose(false);
+    double total = 0;
+    for (int run = 0; run < min_runs || total < min_seconds; run++) {
+        auto t1 = chrono::steady_clock::now();
+        search();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+        r.seconds = run == 0 ? seconds : min(r.seconds, seconds);
+        total += seconds;
+    }
+    r.nodes = nodes();
+    const vector<long long> &counts = s.solution_counts();
+    for (size_t length = 0; length < counts.size(); length++) {
+        if (counts[length] > 0 && r.depth == -1) {
+            r.depth = (int) length;
+        }
+        r.solutions += counts[length];
+    }
+    r.peak_rss = peak_rss_kb();
+    return r;
+}
+
+template<typename searchType>
+function<Result()> single(int max_depth, bool complete, vector<int> hold_lengths = {}) {
+    return [=]() {
+        searchType s;
+        s.set_hold_lengths(hold_lengths);
+        return measure(s, [&] { s.search(max_depth, complete); }, [&] { return s.node_count(); });
+    };
+}
+
+template<typename workerType>
+function<Result()> threaded(int threads, int max_depth, bool complete) {
+    return [=]() {
+        ThreadedSearcheline<workerType> s(threads);
+        return measure(s, [&] { s.search(max_depth, complete); }, [&] { return s.stats.nodes; });
+    };
+}
+
+// name, and how to run it. names can't have spaces
+const vector<pair<string, function<Result()>>> problems = {
+        {"100m",          single<Search100>(50, false)},
+        {"100m_threaded", threaded<Worker100>(2, 50, false)},
+        {"2100m",         single<Search2100>(40, true)},
+        {"2100m_macro",   single<Search2100>(40, true, {2, 4, 8})},
+        {"room3_depth8",  single<SearchRoom<3>>(8, true)},
+        {"room6_depth8",  single<SearchRoom<6>>(8, true)},
+        {"room14_depth8", single<SearchRoom<14>>(8, true)},
+        {"room24_depth8", single<SearchRoom<24>>(8, true)},
+};
+
+map<string, Result> read_baseline(const string &path) {
+    map<string, Result> baseline;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        istringstream ss(line);
+        string name;
+        Result r;
+        double nodes_per_second;
+        if (ss >> name >> r.depth >> r.solutions >> r.nodes >> nodes_per_second >> r.peak_rss) {
+            r.seconds = r.nodes / nodes_per_second;
+            baseline[name] = r;
+        }
+    }
+    return baseline;
+}
+
+void write_baseline(const string &path, const map<string, Result> &baseline) {
+    ofstream out(path);
+    out << "# problem depth solutions nodes nodes/s peak_rss_kB\n";
+    out << "# written by CpplesteBenchmark --record, throughput is only comparable on the machine that recorded it\n";
+    for (auto &[name, r]: baseline) {
+        out << name << " " << r.depth << " " << r.solutions << " " << r.nodes << " " << fixed << setprecision(0)
+            << r.nodes_per_second() << " " << r.peak_rss << "\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    string baseline_path;
+    bool record = false;
+    double tolerance = -1; // no throughput check
+    vector<string> names;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--baseline" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        }
+        else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        }
+        else if (arg == "--record") {
+            record = true;
+        }
+        else if (arg == "--list") {
+            for (auto &p: problems) {
+                cout << p.first << "\n";
+            }
+            return 0;
+        }
+        else {
+            names.push_back(arg);
+        }
+    }
+    if (record && baseline_path.empty()) {
+        cerr << "--record needs --baseline" << endl;
+        return 2;
+    }
+    if (names.empty()) {
+        for (auto &p: problems) {
+            names.push_back(p.first);
+        }
+    }
+    map<string, Result> baseline;
+    if (!baseline_path.empty()) {
+        baseline = read_baseline(baseline_path);
+    }
+
+    bool failed = false;
+    cout << left << setw(16) << "problem" << right << setw(7) << "depth" << setw(11) << "solutions" << setw(12)
+         << "nodes" << setw(10) << "seconds" << setw(12) << "nodes/s" << setw(12) << "peak kB" << endl;
+    for (auto &name: names) {
+        auto it = find_if(problems.begin(), problems.end(), [&](auto &p) { return p.first == name; });
+        if (it == problems.end()) {
+            cerr << "unknown problem " << name << endl;
+            return 2;
+        }
+        Result r = it->second();
+        cout << left << setw(16) << name << right << setw(7) << r.depth << setw(11) << r.solutions << setw(12)
+             << r.nodes << setw(10) << fixed << setprecision(2) << r.seconds << setw(12) << setprecision(0)
+             << r.nodes_per_second() << setw(12) << r.peak_rss << endl;
+        if (record) {
+            baseline[name] = r;
+            continue;
+        }
+        if (baseline_path.empty()) {
+            continue;
+        }
+        auto b = baseline.find(name);
+        if (b == baseline.end()) {
+            cout << "  no baseline" << endl;
+            continue;
+        }
+        const Result &e = b->second;
+        if (r.depth != e.depth || r.solutions != e.solutions || r.nodes != e.nodes) {
+            cout << "  FAIL: expected depth " << e.depth << ", " << e.solutions << " solutions, " << e.nodes
+                 << " nodes" << endl;
+            failed = true;
+        }
+        if (tolerance >= 0 && r.nodes_per_second() < e.nodes_per_second() * (1 - tolerance)) {
+            cout << "  FAIL: throughput dropped from " << e.nodes_per_second() << " nodes/s" << endl;
+            failed = true;
+        }
+    }
+    if (record) {
+        write_baseline(baseline_path, baseline);
+    }
+    return failed ? 1 : 0;
+}
@@ -32,6 +32,7 @@ void Celeste::base_obj::update() {}
 void Celeste::base_obj::draw() {}
 
 bool Celeste::base_obj::is_solid(int ox, int oy) const {
+    CPPLESTE_PROFILE_COUNT(g.get(), is_solid);
     if (oy > 0 && !collide<platform>(ox, 0) && collide<platform>(ox, oy)) {
         return true;
     }
@@ -40,6 +41,33 @@ bool Celeste::base_obj::is_solid(int ox, int oy) const {
            collide<fake_wall>(ox, oy);
 }
 
+// everything but the game references and the per type constants (ascii and type)
+bool Celeste::base_obj::same_base(const base_obj &o) const {
+    return x == o.x && y == o.y && collideable == o.collideable && solids == o.solids && spr == o.spr &&
+           type_id == o.type_id && flip.x == o.flip.x && flip.y == o.flip.y && hitbox.x == o.hitbox.x &&
+           hitbox.y == o.hitbox.y && hitbox.w == o.hitbox.w && hitbox.h == o.hitbox.h && spd.x == o.spd.x &&
+           spd.y == o.spd.y && rem.x == o.rem.x && rem.y == o.rem.y;
+}
+
+void Celeste::base_obj::hash_base(Hasher &h) const {
+    h.mix(x);
+    h.mix(y);
+    h.mix(collideable);
+    h.mix(solids);
+    h.mix(spr);
+    h.mix(type_id);
+    h.mix(flip.x);
+    h.mix(flip.y);
+    h.mix(hitbox.x);
+    h.mix(hitbox.y);
+    h.mix(hitbox.w);
+    h.mix(hitbox.h);
+    h.mix(spd.x);
+    h.mix(spd.y);
+    h.mix(rem.x);
+    h.mix(rem.y);
+}
+
 bool Celeste::base_obj::is_ice(int ox, int oy) const {
     return g.get().tile_flag_at(x + hitbox.x + ox, y + hitbox.y + oy, hitbox.w, hitbox.h, 4);
 }
@@ -154,6 +182,25 @@ Celeste::player_spawn *Celeste::player_spawn::clone() const {
     return new player_spawn(*this);
 }
 
+void Celeste::player_spawn::copy_from(const base_obj &other) {
+    *this = static_cast<const player_spawn &>(other);
+}
+
+bool Celeste::player_spawn::equals(const base_obj &other) const {
+    auto &o = static_cast<const player_spawn &>(other);
+    return same_base(o) &&
+           target == o.target &&
+           state == o.state &&
+           delay == o.delay;
+}
+
+void Celeste::player_spawn::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(target);
+    h.mix(state);
+    h.mix(delay);
+}
+
 Celeste::player::player(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii = ":D";
     type = "player";
@@ -282,6 +329,41 @@ Celeste::player *Celeste::player::clone() const {
     return new player(*this);
 }
 
+void Celeste::player::copy_from(const base_obj &other) {
+    *this = static_cast<const player &>(other);
+}
+
+bool Celeste::player::equals(const base_obj &other) const {
+    auto &o = static_cast<const player &>(other);
+    return same_base(o) &&
+           p_jump == o.p_jump &&
+           p_dash == o.p_dash &&
+           grace == o.grace &&
+           jbuffer == o.jbuffer &&
+           djump == o.djump &&
+           dash_time == o.dash_time &&
+           dash_effect_time == o.dash_effect_time &&
+           dash_target.x == o.dash_target.x &&
+           dash_target.y == o.dash_target.y &&
+           dash_accel.x == o.dash_accel.x &&
+           dash_accel.y == o.dash_accel.y;
+}
+
+void Celeste::player::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(p_jump);
+    h.mix(p_dash);
+    h.mix(grace);
+    h.mix(jbuffer);
+    h.mix(djump);
+    h.mix(dash_time);
+    h.mix(dash_effect_time);
+    h.mix(dash_target.x);
+    h.mix(dash_target.y);
+    h.mix(dash_accel.x);
+    h.mix(dash_accel.y);
+}
+
 Celeste::balloon::balloon(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="()";
     type="balloon";
@@ -315,6 +397,21 @@ Celeste::balloon *Celeste::balloon::clone() const {
     return new balloon(*this);
 }
 
+void Celeste::balloon::copy_from(const base_obj &other) {
+    *this = static_cast<const balloon &>(other);
+}
+
+bool Celeste::balloon::equals(const base_obj &other) const {
+    auto &o = static_cast<const balloon &>(other);
+    return same_base(o) &&
+           timer == o.timer;
+}
+
+void Celeste::balloon::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(timer);
+}
+
 Celeste::platform::platform(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii = "oo";
     type = "platform";
@@ -349,6 +446,23 @@ Celeste::platform *Celeste::platform::clone() const {
     return new platform(*this);
 }
 
+void Celeste::platform::copy_from(const base_obj &other) {
+    *this = static_cast<const platform &>(other);
+}
+
+bool Celeste::platform::equals(const base_obj &other) const {
+    auto &o = static_cast<const platform &>(other);
+    return same_base(o) &&
+           last == o.last &&
+           dir == o.dir;
+}
+
+void Celeste::platform::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(last);
+    h.mix(dir);
+}
+
 Celeste::fruit::fruit(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="{}";
     type = "fruit";
@@ -377,6 +491,23 @@ Celeste::fruit *Celeste::fruit::clone() const {
     return new fruit(*this);
 }
 
+void Celeste::fruit::copy_from(const base_obj &other) {
+    *this = static_cast<const fruit &>(other);
+}
+
+bool Celeste::fruit::equals(const base_obj &other) const {
+    auto &o = static_cast<const fruit &>(other);
+    return same_base(o) &&
+           start == o.start &&
+           off == o.off;
+}
+
+void Celeste::fruit::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(start);
+    h.mix(off);
+}
+
 Celeste::fly_fruit::fly_fruit(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="{}";
     type = "fly fruit";
@@ -416,6 +547,25 @@ Celeste::fly_fruit *Celeste::fly_fruit::clone() const {
     return new fly_fruit(*this);
 }
 
+void Celeste::fly_fruit::copy_from(const base_obj &other) {
+    *this = static_cast<const fly_fruit &>(other);
+}
+
+bool Celeste::fly_fruit::equals(const base_obj &other) const {
+    auto &o = static_cast<const fly_fruit &>(other);
+    return same_base(o) &&
+           fly == o.fly &&
+           step == o.step &&
+           solids == o.solids;
+}
+
+void Celeste::fly_fruit::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(fly);
+    h.mix(step);
+    h.mix(solids);
+}
+
 Celeste::fake_wall::fake_wall(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="▓▓";
     type= "fake wall";
@@ -443,6 +593,18 @@ Celeste::fake_wall *Celeste::fake_wall::clone() const {
     return new fake_wall(*this);
 }
 
+void Celeste::fake_wall::copy_from(const base_obj &other) {
+    *this = static_cast<const fake_wall &>(other);
+}
+
+bool Celeste::fake_wall::equals(const base_obj &other) const {
+    return same_base(other);
+}
+
+void Celeste::fake_wall::hash_into(Hasher &h) const {
+    hash_base(h);
+}
+
 Celeste::spring::spring(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="ΞΞ";
     type = "spring";
@@ -452,6 +614,7 @@ Celeste::spring::spring(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile)
 void Celeste::spring::init() {
     hide_for=0;
     hide_in=0;
+    delay=0;
 }
 
 void Celeste::spring::update() {
@@ -495,6 +658,25 @@ Celeste::spring *Celeste::spring::clone() const {
     return new spring(*this);
 }
 
+void Celeste::spring::copy_from(const base_obj &other) {
+    *this = static_cast<const spring &>(other);
+}
+
+bool Celeste::spring::equals(const base_obj &other) const {
+    auto &o = static_cast<const spring &>(other);
+    return same_base(o) &&
+           hide_for == o.hide_for &&
+           hide_in == o.hide_in &&
+           delay == o.delay;
+}
+
+void Celeste::spring::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(hide_for);
+    h.mix(hide_in);
+    h.mix(delay);
+}
+
 Celeste::fall_floor::fall_floor(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii = "▒▒";
     type = "fall floor";
@@ -503,6 +685,7 @@ Celeste::fall_floor::fall_floor(PICO8<Celeste> &p8, Celeste &g, int x, int y, in
 
 void Celeste::fall_floor::init() {
     state = 0;
+    delay = 0;
 }
 
 void Celeste::fall_floor::update() {
@@ -534,6 +717,23 @@ Celeste::fall_floor *Celeste::fall_floor::clone() const {
     return new fall_floor(*this);
 }
 
+void Celeste::fall_floor::copy_from(const base_obj &other) {
+    *this = static_cast<const fall_floor &>(other);
+}
+
+bool Celeste::fall_floor::equals(const base_obj &other) const {
+    auto &o = static_cast<const fall_floor &>(other);
+    return same_base(o) &&
+           state == o.state &&
+           delay == o.delay;
+}
+
+void Celeste::fall_floor::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(state);
+    h.mix(delay);
+}
+
 void Celeste::break_spring(Celeste::spring &s) {
     s.hide_in = 15;
 }
@@ -566,6 +766,18 @@ Celeste::key *Celeste::key::clone() const {
     return new key(*this);
 }
 
+void Celeste::key::copy_from(const base_obj &other) {
+    *this = static_cast<const key &>(other);
+}
+
+bool Celeste::key::equals(const base_obj &other) const {
+    return same_base(other);
+}
+
+void Celeste::key::hash_into(Hasher &h) const {
+    hash_base(h);
+}
+
 
 Celeste::chest::chest(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="╔╗";
@@ -595,6 +807,21 @@ Celeste::chest *Celeste::chest::clone() const {
     return new chest(*this);
 }
 
+void Celeste::chest::copy_from(const base_obj &other) {
+    *this = static_cast<const chest &>(other);
+}
+
+bool Celeste::chest::equals(const base_obj &other) const {
+    auto &o = static_cast<const chest &>(other);
+    return same_base(o) &&
+           timer == o.timer;
+}
+
+void Celeste::chest::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(timer);
+}
+
 Celeste::big_chest::big_chest(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="╔╤";
     type = "big chest";
@@ -627,6 +854,23 @@ void Celeste::big_chest::draw(){
 Celeste::big_chest* Celeste::big_chest::clone() const{
     return new big_chest(*this);
 }
+
+void Celeste::big_chest::copy_from(const base_obj &other) {
+    *this = static_cast<const big_chest &>(other);
+}
+
+bool Celeste::big_chest::equals(const base_obj &other) const {
+    auto &o = static_cast<const big_chest &>(other);
+    return same_base(o) &&
+           state == o.state &&
+           timer == o.timer;
+}
+
+void Celeste::big_chest::hash_into(Hasher &h) const {
+    hash_base(h);
+    h.mix(state);
+    h.mix(timer);
+}
 Celeste::orb::orb(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile) : base_obj(p8, g, x, y, tile) {
     ascii="◖◗";
     type = "orb";
@@ -653,6 +897,18 @@ Celeste::orb* Celeste::orb::clone() const{
     return new orb(*this);
 }
 
+void Celeste::orb::copy_from(const base_obj &other) {
+    *this = static_cast<const orb &>(other);
+}
+
+bool Celeste::orb::equals(const base_obj &other) const {
+    return same_base(other);
+}
+
+void Celeste::orb::hash_into(Hasher &h) const {
+    hash_base(h);
+}
+
 
 Celeste::Celeste(PICO8<Celeste> &p8) :
         p8(p8),
@@ -665,6 +921,8 @@ Celeste::Celeste(PICO8<Celeste> &p8) :
     pause_player=false;
     got_fruit=false;
     prev_got_fruit=false;
+    isolated=false;
+    present=0;
 }
 
 void Celeste::_init() {
@@ -678,18 +936,83 @@ void Celeste::_update() {
         freeze--;
         return;
     }
+    CPPLESTE_PROFILE_COUNT(*this, frames);
+    update_objects();
+    remove_destroyed();
+}
+
+void Celeste::_draw() {
+    if (freeze > 0) {
+        return;
+    }
+    for (auto &o: objects) {
+        CPPLESTE_PROFILE_SCOPE(*this, draw, o->type_id);
+        o->draw();
+    }
+
+    //clear objects destroyed in draw (because chest exists)
+    remove_destroyed();
+}
+
+// same as _update followed by _draw, but only calls the draws that affect gameplay,
+// and clears destroyed objects in the same pass
+void Celeste::_update_headless() {
+    frames = (frames + 1) % 30;
+    if (freeze > 0) {
+        freeze--;
+        if (freeze == 0) {
+            draw_headless();
+        }
+        return;
+    }
+    CPPLESTE_PROFILE_COUNT(*this, frames);
+    update_objects();
+    if (freeze > 0) {
+        remove_destroyed();
+    }
+    else {
+        draw_headless();
+    }
+}
+
+void Celeste::update_objects() {
     if (delay_restart > 0) {
         delay_restart -= 1;
         if (delay_restart == 0) {
             load_room(room.x, room.y);
         }
     }
-    for (auto &o:objects) {
-        if(o!=nullptr){
-            o->move(o->spd.x, o->spd.y);
-            o->update();
+    refresh_present();
+    build_broadphase();
+    isolated = broadphase.player != nullptr && broadphase.candidates.empty();
+    if (isolated) {
+        // fast path: every collision check misses, so objects that only react to the player can be skipped
+        for (auto &o:objects) {
+            if(o!=nullptr && !idle_without_player(*o)){
+                CPPLESTE_PROFILE_SCOPE(*this, update, o->type_id);
+                o->move(o->spd.x, o->spd.y);
+                o->update();
+            }
         }
+        isolated = false;
     }
+    else {
+        std::size_t i = 0;
+        for (auto &o:objects) {
+            if(o!=nullptr){
+                CPPLESTE_PROFILE_SCOPE(*this, update, o->type_id);
+                if (broadphase.player != nullptr) {
+                    broadphase.owner = o.get();
+                    broadphase.owner_near = broadphase.near[i];
+                }
+                o->move(o->spd.x, o->spd.y);
+                o->update();
+            }
+            i++;
+        }
+    }
+    broadphase.player = nullptr;
+    broadphase.owner = nullptr;
 
     //next room transition
     if (next_rm) {
@@ -703,32 +1026,89 @@ void Celeste::_update() {
             std::advance(it,n_objs-1);
             for (; it != objects.end(); it++) {
                 auto &o = *it;
+                CPPLESTE_PROFILE_SCOPE(*this, update, o->type_id);
                 o->move(o->spd.x, o->spd.y);
                 o->update();
             }
         }
     }
+}
 
+// finds the objects close enough to interact with the player this frame:
+// the player moves at most 6px a frame and checks for walls up to 3px away,
+// and no other object moves (or grows its hitbox) by more than 4px a frame
+void Celeste::build_broadphase() {
+    broadphase.player = nullptr;
+    broadphase.owner = nullptr;
+    broadphase.types = 0;
+    broadphase.candidates.clear();
+    broadphase.near.assign(objects.size(), 0);
+    const base_obj *p = nullptr;
+    for (auto &o: objects) {
+        if (o != nullptr && o->type_id == PLAYER) {
+            p = o.get();
+            break;
+        }
+    }
+    if (p == nullptr) {
+        return;
+    }
+    const int reach = Broadphase::reach;
+    double left = p->x + p->hitbox.x - reach;
+    double right = p->x + p->hitbox.x + p->hitbox.w + reach;
+    double top = p->y + p->hitbox.y - reach;
+    double bottom = p->y + p->hitbox.y + p->hitbox.h + reach;
+    std::size_t i = 0;
+    for (auto &o: objects) {
+        // platforms about to wrap around the screen count as near
+        if (o != nullptr && o.get() != p &&
+            ((o->type_id == PLATFORM && (o->x < -15 || o->x > 127)) ||
+             (o->x + o->hitbox.x + o->hitbox.w > left && o->x + o->hitbox.x < right &&
+              o->y + o->hitbox.y + o->hitbox.h > top && o->y + o->hitbox.y < bottom))) {
+            broadphase.candidates.push_back(&o);
+            broadphase.types |= 1u << o->type_id;
+            broadphase.near[i] = 1;
+        }
+        i++;
+    }
+    broadphase.player = p;
+}
 
-    auto it = objects.begin();
-    while (it != objects.end()) {
-        auto nxt = next(it);
-        if (*it == nullptr) {
-            objects.erase(it);
+void Celeste::refresh_present() {
+    present = 0;
+    for (auto &o: objects) {
+        if (o != nullptr) {
+            present |= 1u << o->type_id;
         }
-        it = nxt;
     }
 }
 
-void Celeste::_draw() {
-    if (freeze > 0) {
-        return;
+// objects whose update does nothing while the player is out of reach
+bool Celeste::idle_without_player(const base_obj &o) {
+    if (o.spd.x != 0 || o.spd.y != 0 || o.rem.x != 0 || o.rem.y != 0) {
+        return false;
     }
-    for (auto &o: objects) {
-        o->draw();
+    switch (o.type_id) {
+        case FAKE_WALL:
+            return o.hitbox.w == 16 && o.hitbox.h == 16;
+        case KEY:
+            return true;
+        case FALL_FLOOR:
+            return static_cast<const fall_floor &>(o).state == 0;
+        case SPRING: {
+            auto &s = static_cast<const spring &>(o);
+            return s.hide_for <= 0 && s.spr == 18 && s.hide_in <= 0;
+        }
+        case BALLOON: {
+            auto &b = static_cast<const balloon &>(o);
+            return b.spr != 22 || b.timer <= 0;
+        }
+        default:
+            return false;
     }
+}
 
-    //clear objects destroyed in draw (because chest exists)
+void Celeste::remove_destroyed() {
     auto it = objects.begin();
     while (it != objects.end()) {
         auto nxt = next(it);
@@ -739,6 +1119,24 @@ void Celeste::_draw() {
     }
 }
 
+void Celeste::draw_headless() {
+    // objects appended while drawing (the big chest's orb) are still drawn this frame, like in _draw
+    auto it = objects.begin();
+    while (it != objects.end()) {
+        auto &o = *it;
+        if (o != nullptr && (o->type_id == PLAYER || o->type_id == BIG_CHEST || o->type_id == ORB)) {
+            CPPLESTE_PROFILE_SCOPE(*this, draw, o->type_id);
+            o->draw();
+        }
+        if (*it == nullptr) {
+            it = objects.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+}
+
 int Celeste::level_index() {
     return room.x + room.y * 8;
 }
@@ -763,9 +1161,21 @@ void Celeste::load_room(int x, int y) {
     prev_got_fruit=got_fruit;
     got_fruit = false;
 
-    objects.clear();
     room.x = x;
     room.y = y;
+    if (x < 0 || x >= 8 || y < 0 || y >= 4) {
+        objects.clear();
+        present = 0;
+        spawn_room_objects();
+        return;
+    }
+    const RoomPrototype &proto = room_prototype(x, y);
+    copy_objects(objects, proto.objects);
+    present = proto.present;
+}
+
+// spawns the objects of the current room's tiles
+void Celeste::spawn_room_objects() {
     for (int tx = 0; tx < 16; tx++) {
         for (int ty = 0; ty < 16; ty++) {
             int tile = p8.mget(room.x * 16 + tx, room.y * 16 + ty);
@@ -810,9 +1220,62 @@ void Celeste::load_room(int x, int y) {
     }
 }
 
+// the objects room (x, y) spawns with, rebuilt if the map changed since
+const Celeste::RoomPrototype &Celeste::room_prototype(int x, int y) {
+    if (prototypes.empty()) {
+        prototypes.resize(32);
+    }
+    RoomPrototype &proto = prototypes[x + y * 8];
+    if (!proto.built || proto.revision != p8.map_revision()) {
+        // spawn into an empty object list, then move the result into the prototype
+        objlist saved;
+        std::swap(saved, objects);
+        unsigned saved_present = present;
+        Pair<int> saved_room = room;
+        room = Pair<int>(x, y);
+        present = 0;
+        spawn_room_objects();
+        proto.objects = std::move(objects);
+        proto.present = present;
+        objects = std::move(saved);
+        present = saved_present;
+        room = saved_room;
+        proto.built = true;
+        proto.revision = p8.map_revision();
+    }
+    return proto;
+}
+
+// makes dst a copy of src, reusing the objects already in dst where the types line up
+// only allocates when the object set differs
+void Celeste::copy_objects(objlist &dst, const objlist &src) {
+    auto d = dst.begin();
+    for (auto &o: src) {
+        if (d == dst.end()) {
+            dst.emplace_back(o ? o->clone() : nullptr);
+            continue;
+        }
+        if (o == nullptr) {
+            d->reset();
+        }
+        else if (*d != nullptr && (*d)->type_id == o->type_id) {
+            (*d)->copy_from(*o);
+        }
+        else {
+            d->reset(o->clone());
+        }
+        ++d;
+    }
+    dst.erase(d, dst.end());
+}
+
 template<typename obj>
 obj &Celeste::init_object(int x, int y, int tile) {
     objects.push_back(std::make_unique<obj>(p8, *this, x, y, tile));
+    present |= 1u << obj::type_enum;
+    // the candidates don't include it
+    broadphase.player = nullptr;
+    broadphase.owner = nullptr;
     auto &o = objects.back();
     o->init();
     return static_cast<obj &>(*o);
@@ -869,6 +1332,42 @@ double Celeste::sin(double a){
 }
 
 bool Celeste::tile_flag_at(int x, int y, int w, int h, int flag) const{
+    CPPLESTE_PROFILE_COUNT(*this, tile_flag_at);
+    if (flag < 0 || flag >= TerrainMemo::flags) {
+        return compute_tile_flag_at(x, y, w, h, flag);
+    }
+    if (terrain.room_x != room.x || terrain.room_y != room.y || terrain.revision != p8.map_revision()) {
+        terrain.room_x = room.x;
+        terrain.room_y = room.y;
+        terrain.revision = p8.map_revision();
+        terrain.built = 0;
+    }
+    auto &rows = terrain.rows[flag];
+    if (!(terrain.built & (1u << flag))) {
+        for (int j = 0; j < 16; j++) {
+            rows[j] = 0;
+            for (int i = 0; i < 16; i++) {
+                rows[j] |= p8.fget(tile_at(i, j), flag) << i;
+            }
+        }
+        terrain.built |= 1u << flag;
+    }
+    // the same tiles compute_tile_flag_at checks
+    int i0 = max(0, x / 8);
+    int i1 = min(15, (x + w - 1) / 8);
+    if (i0 > i1) {
+        return false;
+    }
+    unsigned columns = (2u << i1) - (1u << i0);
+    for (int j = max(0, y / 8); j <= min(15, (y + h - 1) / 8); j++) {
+        if (rows[j] & columns) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Celeste::compute_tile_flag_at(int x, int y, int w, int h, int flag) const{
     for (int i = max(0, x / 8); i <= min(15, (x + w - 1) / 8); i++) {
         for (int j = max(0, y / 8); j <= min(15, (y + h - 1) / 8); j++) {
 
@@ -885,6 +1384,7 @@ int Celeste::tile_at(int x, int y) const{
 }
 
 bool Celeste::spikes_at(int x, int y, int w, int h, double spdx, double spdy) const{
+    CPPLESTE_PROFILE_COUNT(*this, spikes_at);
     for (int i = max(0, x / 8); i <= min(15, (x + w - 1) / 8); i++) {
         for (int j = max(0, y / 8); j <= min(15, (y + h - 1) / 8); j++) {
             int tile = tile_at(i, j);
@@ -958,3 +1458,44 @@ std::ostream &operator<<(std::ostream &os, Celeste &c) {
     }
     return os;
 }
+
+#ifdef CPPLESTE_PROFILE
+Celeste::Profile &Celeste::Profile::operator+=(const Profile &other) {
+    frames += other.frames;
+    for (int i = 0; i < type_count; i++) {
+        update.calls[i] += other.update.calls[i];
+        update.cycles[i] += other.update.cycles[i];
+        draw.calls[i] += other.draw.calls[i];
+        draw.cycles[i] += other.draw.cycles[i];
+        check_hits[i] += other.check_hits[i];
+        check_misses[i] += other.check_misses[i];
+        check_skips[i] += other.check_skips[i];
+    }
+    is_solid += other.is_solid;
+    tile_flag_at += other.tile_flag_at;
+    spikes_at += other.spikes_at;
+    return *this;
+}
+
+void Celeste::Profile::report(std::ostream &os) const {
+    const char *names[type_count] = {"player_spawn", "player", "balloon", "platform", "fruit", "fly_fruit",
+                                     "fake_wall", "spring", "fall_floor", "key", "chest", "big_chest", "orb"};
+    os << "frames: " << frames << "\n";
+    os << std::left << std::setw(14) << "type" << std::right << std::setw(12) << "updates" << std::setw(16)
+       << "update cycles" << std::setw(10) << "per call" << std::setw(12) << "draws" << std::setw(16)
+       << "draw cycles" << std::setw(14) << "check hits" << std::setw(14) << "misses" << std::setw(14)
+       << "skips" << "\n";
+    for (int i = 0; i < type_count; i++) {
+        if (update.calls[i] == 0 && draw.calls[i] == 0 && check_hits[i] == 0 && check_misses[i] == 0 &&
+            check_skips[i] == 0) {
+            continue;
+        }
+        os << std::left << std::setw(14) << names[i] << std::right << std::setw(12) << update.calls[i]
+           << std::setw(16) << update.cycles[i] << std::setw(10)
+           << (update.calls[i] > 0 ? update.cycles[i] / update.calls[i] : 0) << std::setw(12) << draw.calls[i]
+           << std::setw(16) << draw.cycles[i] << std::setw(14) << check_hits[i] << std::setw(14) << check_misses[i]
+           << std::setw(14) << check_skips[i] << "\n";
+    }
+    os << "is_solid: " << is_solid << ", tile_flag_at: " << tile_flag_at << ", spikes_at: " << spikes_at << "\n";
+}
+#endif
@@ -12,9 +12,27 @@
 #include <vector>
 #include <functional>
 #include <numbers>
+#include <cstdint>
+#include <bit>
+#include <type_traits>
 
 #include "../PICO8.h"
 
+// CPPLESTE_PROFILE builds count object updates and collision queries, see Celeste::Profile
+// otherwise these expand to nothing
+#ifdef CPPLESTE_PROFILE
+#include <array>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#define CPPLESTE_PROFILE_COUNT(g, counter) ((g).profile.counter++)
+#define CPPLESTE_PROFILE_SCOPE(g, timing, type) Celeste::Profile::Scope profile_scope((g).profile.timing, (type))
+#else
+#define CPPLESTE_PROFILE_COUNT(g, counter) ((void) 0)
+#define CPPLESTE_PROFILE_SCOPE(g, timing, type) ((void) 0)
+#endif
+
 struct Celeste{
     enum ObjType {BASE_OBJ=-1, PLAYER_SPAWN, PLAYER, BALLOON, PLATFORM, FRUIT, FLY_FRUIT, FAKE_WALL, SPRING, FALL_FLOOR, KEY, CHEST, BIG_CHEST, ORB};
     template<typename T>
@@ -31,6 +49,25 @@ struct Celeste{
         int w;
         Rect(int x, int y, int w, int h);
     };
+    // FNV-1a over the values mixed in. doubles are mixed by their bit pattern (with -0 as 0, since they compare equal),
+    // so hashes are only comparable between runs of the same build
+    struct Hasher {
+        std::uint64_t value = 14695981039346656037ull;
+        template<typename T>
+        void mix(T v) {
+            std::uint64_t bits;
+            if constexpr (std::is_floating_point_v<T>) {
+                bits = std::bit_cast<std::uint64_t>(double(v) == 0 ? 0.0 : double(v));
+            }
+            else {
+                bits = (std::uint64_t) v;
+            }
+            for (int i = 0; i < 8; i++) {
+                value ^= (bits >> (i * 8)) & 0xff;
+                value *= 1099511628211ull;
+            }
+        }
+    };
     struct base_obj{
         const static ObjType type_enum=BASE_OBJ;
         double x;
@@ -57,20 +94,65 @@ struct Celeste{
         bool is_solid(int ox, int oy) const;
         bool is_ice(int ox, int oy) const;
 
+        // whether other's hitbox overlaps this one's moved by (ox, oy)
+        bool overlaps(const base_obj &other, int ox, int oy) const {
+            return other.x + other.hitbox.x + other.hitbox.w > x + hitbox.x + ox &&
+                   other.y + other.hitbox.y + other.hitbox.h > y + hitbox.y + oy &&
+                   other.x + other.hitbox.x < x + hitbox.x + hitbox.w + ox &&
+                   other.y + other.hitbox.y < y + hitbox.y + hitbox.h + oy;
+        }
+
         template<typename obj>
         obj* check(int ox, int oy) const{
-            for (auto &other: g.get().objects) {
+            Celeste &game = g.get();
+            // nothing can touch anything during a frame where the player is isolated,
+            // and there's nothing to find if the room has no objects of this type
+            if (game.isolated || !game.may_contain(obj::type_enum)) {
+                CPPLESTE_PROFILE_COUNT(game, check_skips[obj::type_enum]);
+                return nullptr;
+            }
+            const Broadphase &bp = game.broadphase;
+            if (bp.owner == this) {
+                // the player only has to look at the objects around it
+                if (this == bp.player) {
+                    if (bp.types & (1u << obj::type_enum)) {
+                        for (auto *slot: bp.candidates) {
+                            base_obj *other = slot->get();
+                            if (other != nullptr && other->type_id == obj::type_enum && other->collideable &&
+                                overlaps(*other, ox, oy)) {
+                                CPPLESTE_PROFILE_COUNT(game, check_hits[obj::type_enum]);
+                                return static_cast<obj*>(other);
+                            }
+                        }
+                    }
+                    CPPLESTE_PROFILE_COUNT(game, check_misses[obj::type_enum]);
+                    return nullptr;
+                }
+                // and objects away from it can't reach it
+                if (obj::type_enum == PLAYER && !bp.owner_near) {
+                    CPPLESTE_PROFILE_COUNT(game, check_skips[obj::type_enum]);
+                    return nullptr;
+                }
+            }
+            for (auto &other: game.objects) {
                 if (other!=nullptr && other-> type_id == obj::type_enum && other.get() != this && other->collideable &&
-                    other->x + other->hitbox.x + other->hitbox.w > x + hitbox.x + ox &&
-                    other->y + other->hitbox.y + other->hitbox.h > y + hitbox.y + oy &&
-                    other->x + other->hitbox.x < x + hitbox.x + hitbox.w + ox &&
-                    other->y + other->hitbox.y < y + hitbox.y + hitbox.h + oy) {
+                    overlaps(*other, ox, oy)) {
+                    CPPLESTE_PROFILE_COUNT(game, check_hits[obj::type_enum]);
                     return static_cast<obj*>(other.get());
                 }
             }
+            CPPLESTE_PROFILE_COUNT(game, check_misses[obj::type_enum]);
             return nullptr;
         }
         virtual base_obj* clone() const=0;
+        // overwrite this object with other, which must be of the same type. unlike clone this doesn't allocate
+        virtual void copy_from(const base_obj &other)=0;
+        // whether this is in the same state as other, which must be of the same type
+        virtual bool equals(const base_obj &other) const=0;
+        bool same_base(const base_obj &other) const;
+        // mixes what equals compares into h, so objects that are equal hash the same
+        virtual void hash_into(Hasher &h) const=0;
+        void hash_base(Hasher &h) const;
 
         template<typename obj>
         bool collide(int ox, int oy) const {// change: the return of collide
@@ -91,6 +173,9 @@ struct Celeste{
         void init() override;
         void update() override;
         player_spawn* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
 
     };
     struct player : public base_obj{
@@ -109,6 +194,9 @@ struct Celeste{
         void update() override;
         void draw() override;
         player* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
 
     };
     struct balloon : public base_obj{
@@ -118,6 +206,9 @@ struct Celeste{
         void init() override;
         void update() override;
         balloon* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
     struct platform : public base_obj{
         const static ObjType type_enum=PLATFORM;
@@ -127,6 +218,9 @@ struct Celeste{
         void init() override;
         void update() override;
         platform* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
     struct fruit : public base_obj{
         const static ObjType type_enum=FRUIT;
@@ -136,6 +230,9 @@ struct Celeste{
         void init() override;
         void update() override;
         fruit* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
     struct fly_fruit : public base_obj{
         const static ObjType type_enum=FLY_FRUIT;
@@ -146,12 +243,18 @@ struct Celeste{
         void init() override;
         void update() override;
         fly_fruit* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
     struct fake_wall : public base_obj{
         const static ObjType type_enum=FAKE_WALL;
         fake_wall(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile=-1);
         void update() override;
         fake_wall* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
     struct spring : public base_obj{
         const static ObjType type_enum=SPRING;
@@ -162,6 +265,9 @@ struct Celeste{
         void init() override;
         void update() override;
         spring* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
     struct fall_floor: public base_obj{
         const static ObjType type_enum=FALL_FLOOR;
@@ -171,6 +277,9 @@ struct Celeste{
         void init() override;
         void update() override;
         fall_floor* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
 
     struct big_chest: public base_obj{
@@ -181,6 +290,9 @@ struct Celeste{
         void init() override;
         void draw() override;
         big_chest* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
 
     struct orb: public base_obj{
@@ -189,6 +301,9 @@ struct Celeste{
         void init() override;
         void draw() override;
         orb* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
 
 
@@ -199,6 +314,9 @@ struct Celeste{
         key(PICO8<Celeste> &p8, Celeste &g, int x, int y, int tile=-1);
         void update() override;
         key* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
     };
     struct chest : public base_obj{
         const static ObjType type_enum=CHEST;
@@ -207,10 +325,44 @@ struct Celeste{
         void init() override;
         void update() override;
         chest* clone() const override;
+        void copy_from(const base_obj &other) override;
+        bool equals(const base_obj &other) const override;
+        void hash_into(Hasher &h) const override;
+    };
+    using objlist = std::list<std::unique_ptr<base_obj>>;
+    // the objects a room spawns with, so loading it again only copies them
+    struct RoomPrototype {
+        bool built = false;
+        unsigned revision = 0; // map revision it was built from
+        objlist objects;
+        unsigned present = 0;
+    };
+    // the tiles of the current room with each flag, as a bit per column in every row, so tile_flag_at only tests
+    // the rows the hitbox covers whatever its size. built on first use, and again when the room or the map changes
+    struct TerrainMemo {
+        static const int flags = 8;
+        int room_x = -1;
+        int room_y = -1;
+        unsigned revision = 0;
+        unsigned built = 0; // bit per flag
+        std::uint16_t rows[flags][16];
+    };
+    // what can collide with the player this frame, found in one pass over the objects at its start: the objects
+    // within reach of the player (see build_broadphase). the player's checks only go through those, and checks
+    // for the player by the others miss. dropped for the rest of the frame when an object spawns
+    struct Broadphase {
+        static const int reach = 16;
+        const base_obj *player = nullptr; // nullptr when there's no player, or the lists are out of date
+        const base_obj *owner = nullptr; // the object being updated, while player is set
+        bool owner_near = false; // whether owner is one of the candidates
+        unsigned types = 0; // bit per ObjType among the candidates
+        std::vector<const std::unique_ptr<base_obj> *> candidates; // in objects order, so the first hit is the same
+        std::vector<std::uint8_t> near; // by position in objects, whether the object is a candidate
     };
     PICO8<Celeste>& p8;
     Pair<int> room;
-    std::list<std::unique_ptr<base_obj>> objects;
+    objlist objects;
+    std::vector<RoomPrototype> prototypes; // by level index
     int freeze;
     int delay_restart;
     bool pause_player;
@@ -222,6 +374,61 @@ struct Celeste{
     bool loop_mode;
     bool got_fruit;
     bool prev_got_fruit;
+    mutable TerrainMemo terrain;
+    bool isolated; // set while updating the objects of a frame in which nothing can reach the player
+    unsigned present; // bit per ObjType that may be in objects (a superset, refreshed every frame)
+    Broadphase broadphase;
+#ifdef CPPLESTE_PROFILE
+    // what the game spent its frames on since it was created (or since profile.reset())
+    // cycles are timestamp counter ticks on x86, and ns elsewhere
+    struct Profile {
+        static const int type_count = ORB + 1; // counters are indexed by ObjType
+        struct Timing {
+            std::array<unsigned long long, type_count> calls{};
+            std::array<unsigned long long, type_count> cycles{};
+        };
+        // adds the time until it goes out of scope to timing
+        struct Scope {
+            Timing &timing;
+            int type;
+            unsigned long long start;
+            Scope(Timing &timing, int type) : timing(timing), type(type), start(now()) {}
+            ~Scope() {
+                timing.calls[type]++;
+                timing.cycles[type] += now() - start;
+            }
+        };
+
+        unsigned long long frames = 0; // frames the objects were updated in, not counting freeze frames
+        Timing update; // move and update of every object
+        Timing draw; // draw, only the draws with side effects in headless steps
+        // check<T> (and collide<T>) calls by T: found an object, found none, or skipped the search because
+        // there's no T in the room, the player is isolated or it's a check for a player out of reach
+        std::array<unsigned long long, type_count> check_hits{};
+        std::array<unsigned long long, type_count> check_misses{};
+        std::array<unsigned long long, type_count> check_skips{};
+        unsigned long long is_solid = 0;
+        unsigned long long tile_flag_at = 0;
+        unsigned long long spikes_at = 0;
+
+        static unsigned long long now() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+        void reset() {
+            *this = Profile();
+        }
+        // for summing the profiles of several games, e.g. one per thread
+        Profile &operator+=(const Profile &other);
+        // a table of the counters by object type
+        void report(std::ostream &os) const;
+    };
+    mutable Profile profile;
+#endif
     const static int k_left=0;
     const static int k_right=1;
     const static int k_up=2;
@@ -233,10 +440,23 @@ struct Celeste{
     void _init();
     void _update();
     void _draw();
+    void _update_headless();
+    void update_objects();
+    void remove_destroyed();
+    void draw_headless();
+    void build_broadphase();
+    static bool idle_without_player(const base_obj &o);
+    void refresh_present();
+    bool may_contain(ObjType type) const{
+        return (present & (1u << type)) != 0;
+    }
     int level_index();
     void restart_room();
     void next_room();
     void load_room(int x, int y);
+    void spawn_room_objects();
+    const RoomPrototype &room_prototype(int x, int y);
+    static void copy_objects(objlist &dst, const objlist &src);
 
     template<typename obj>
     obj& init_object(int x, int y, int tile=-1);
@@ -252,6 +472,7 @@ struct Celeste{
     static double sin(double a);
     static int mod(int a, int b);
     bool tile_flag_at(int x, int y, int w, int h, int flag) const;
+    bool compute_tile_flag_at(int x, int y, int w, int h, int flag) const;
     int tile_at(int x, int y) const;
     bool spikes_at(int x, int y, int w, int h, double spdx, double spdy) const;
     const std::string map_data=\
@@ -12,6 +12,11 @@
 #include <chrono>
 #include <thread>
 #include <vector>
+#include <cstdint>
+#include <bit>
+#include <array>
+#include <cctype>
+#include <stdexcept>
 
 namespace utils {
     template<typename Cart>
@@ -90,29 +95,71 @@ namespace utils {
         }
     }
 
+    // starts level_id on an instance that may have played something else before: clears the state a previous run
+    // leaves behind (freezes, a pending restart or transition, the dash the orb gives, fruit, the frame count), then
+    // loads the room and skips the player spawn
     template<typename Cart>
-    void replace_room(PICO8<Cart> &p8, int level_id, std::string room_data) {
-        std::map<char, int> tiles = {
-                {'w', 32}, // terrain
-                {'^', 17}, // up spike
-                {'v', 27}, // down spike
-                {'<', 59}, // left spike
-                {'>', 43}, // right spike
-                {'b', 22}, // balloon
-                {'c', 23}, // crumble block
-                {'s', 18}, // spring
-                {'p', 1},  // player spawn
-                {'.', 0}   // empty
-        };
-        room_data.erase(std::remove_if(room_data.begin(),room_data.end(),isspace),room_data.end());
-        int rx = level_id % 8;
-        int ry = level_id / 8;
-        for (int tx = 0; tx < 16; tx++) {
-            for (int ty = 0; ty < 16; ty++) {
-                char tile = room_data[tx + 16 * ty];
-                p8.mset(rx * 16 + tx, ry * 16 + ty, tiles[tile]); // if tile doesn't exist tiles[tile] will return 0
+    void start_room(PICO8<Cart> &p8, int level_id) {
+        auto &g = p8.game();
+        g.freeze = 0;
+        g.delay_restart = 0;
+        g.pause_player = false;
+        g.next_rm = false;
+        g.max_djump = 1;
+        g.frames = 0;
+        g.got_fruit = false;
+        g.prev_got_fruit = false;
+        load_room(p8, level_id);
+        skip_player_spawn(p8);
+    }
+
+    // a room's tiles, by tx + 16 * ty
+    using room_tiles = std::array<int, 256>;
+
+    // the tile a character of room data stands for, 0 (empty) for characters it doesn't know
+    inline int room_tile(char c) {
+        switch (c) {
+            case 'w': return 32; // terrain
+            case '^': return 17; // up spike
+            case 'v': return 27; // down spike
+            case '<': return 59; // left spike
+            case '>': return 43; // right spike
+            case 'b': return 22; // balloon
+            case 'c': return 23; // crumble block
+            case 's': return 18; // spring
+            case 'p': return 1;  // player spawn
+            default: return 0;   // '.' empty
+        }
+    }
+
+    // parses room data: 256 tile characters, row by row, whitespace is ignored
+    inline room_tiles decode_room(const std::string &room_data) {
+        room_tiles tiles{};
+        std::size_t n = 0;
+        for (char c: room_data) {
+            if (std::isspace((unsigned char) c)) {
+                continue;
+            }
+            if (n == tiles.size()) {
+                throw std::runtime_error("room data has more than 256 tiles");
             }
+            tiles[n++] = room_tile(c);
+        }
+        if (n != tiles.size()) {
+            throw std::runtime_error("room data has " + std::to_string(n) + " tiles instead of 256");
         }
+        return tiles;
+    }
+
+    // writes tiles over the room of level_id in the map. the room's objects spawn from them the next time it's loaded
+    template<typename Cart>
+    void apply_room(PICO8<Cart> &p8, int level_id, const room_tiles &tiles) {
+        p8.mset_block(level_id % 8 * 16, level_id / 8 * 16, 16, 16, tiles.data());
+    }
+
+    template<typename Cart>
+    void replace_room(PICO8<Cart> &p8, int level_id, const std::string &room_data) {
+        apply_room(p8, level_id, decode_room(room_data));
     }
 
     template<typename Cart>
@@ -137,6 +184,30 @@ namespace utils {
         p2.djump = djump;
     }
 
+    // hash of the gameplay relevant part of the game state: the game's flags, and every object the way its equals
+    // compares it (see Cart::Hasher, only meant for comparing runs of the same build)
+    template<typename Cart>
+    std::uint64_t state_hash(PICO8<Cart> &p8) {
+        typename Cart::Hasher h;
+        auto &g = p8.game();
+        h.mix(g.room.x);
+        h.mix(g.room.y);
+        h.mix(g.freeze);
+        h.mix(g.delay_restart);
+        h.mix(g.max_djump);
+        h.mix(g.has_dashed);
+        h.mix(g.has_key);
+        h.mix(g.got_fruit);
+        h.mix(g.pause_player);
+        for (auto &o: g.objects) {
+            if (o == nullptr) {
+                continue;
+            }
+            o->hash_into(h);
+        }
+        return h.value;
+    }
+
     template<typename Cart>
     void watch_inputs(PICO8<Cart> &p8, const std::vector<int>& inputs){
         std::cout<<p8.input_display()<<std::endl;
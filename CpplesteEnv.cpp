@@ -0,0 +1,251 @@
+#include "CpplesteEnv.h"
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include "PICO8.h"
+#include "Carts/Celeste.h"
+#include "CelesteUtils.h"
+
+namespace {
+    struct Env {
+        std::unique_ptr<PICO8<Celeste>> p8;
+        int frames = 0;
+    };
+
+    Celeste::player *find_player(Celeste &g) {
+        Celeste::base_obj *p = g.get_player();
+        return p != nullptr && p->type_id == Celeste::PLAYER ? static_cast<Celeste::player *>(p) : nullptr;
+    }
+}
+
+struct cppleste_env_pool {
+    cppleste_env_config config;
+    std::vector<Env> envs;
+
+    // the calling thread takes the first share of every job, the workers the rest
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    std::function<void(int, int)> job; // runs envs [begin, end)
+    unsigned long long generation = 0;
+    int running = 0;
+    bool quit = false;
+
+    explicit cppleste_env_pool(const cppleste_env_config &config) : config(config) {
+        envs.resize(config.env_count);
+        for (auto &e: envs) {
+            e.p8 = std::make_unique<PICO8<Celeste>>();
+            utils::enable_loop_mode(*e.p8);
+        }
+        int threads = config.thread_count > 0 ? config.thread_count : (int) std::thread::hardware_concurrency();
+        threads = std::clamp(threads, 1, config.env_count);
+        for (int i = 1; i < threads; i++) {
+            workers.emplace_back(&cppleste_env_pool::work, this, i);
+        }
+    }
+
+    ~cppleste_env_pool() {
+        {
+            std::lock_guard<std::mutex> l(lock);
+            quit = true;
+        }
+        start_cv.notify_all();
+        for (auto &t: workers) {
+            t.join();
+        }
+    }
+
+    int share_begin(int k) const {
+        return (int) ((long long) envs.size() * k / (workers.size() + 1));
+    }
+
+    void work(int k) {
+        unsigned long long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> l(lock);
+                start_cv.wait(l, [&] { return quit || generation != seen; });
+                if (quit) {
+                    return;
+                }
+                seen = generation;
+            }
+            job(share_begin(k), share_begin(k + 1));
+            {
+                std::lock_guard<std::mutex> l(lock);
+                if (--running == 0) {
+                    done_cv.notify_one();
+                }
+            }
+        }
+    }
+
+    void run(std::function<void(int, int)> f) {
+        {
+            std::lock_guard<std::mutex> l(lock);
+            job = std::move(f);
+            running = (int) workers.size();
+            generation++;
+        }
+        start_cv.notify_all();
+        job(share_begin(0), share_begin(1));
+        std::unique_lock<std::mutex> l(lock);
+        done_cv.wait(l, [&] { return running == 0; });
+    }
+
+    void reset(Env &e) {
+        utils::start_room(*e.p8, config.room);
+        e.frames = 0;
+    }
+
+    static void observe(Env &e, float *o) {
+        Celeste &g = e.p8->game();
+        std::fill(o, o + CPPLESTE_ENV_OBS_SIZE, 0.0f);
+        Celeste::player *p = find_player(g);
+        if (p != nullptr) {
+            float player[CPPLESTE_ENV_OBS_PLAYER] = {
+                    1, (float) p->x, (float) p->y, (float) p->spd.x, (float) p->spd.y, (float) p->rem.x,
+                    (float) p->rem.y, (float) p->djump, (float) p->dash_time, (float) p->grace,
+                    (float) p->is_solid(0, 1), (float) p->p_jump, (float) p->p_dash
+            };
+            std::copy(player, player + CPPLESTE_ENV_OBS_PLAYER, o);
+        }
+        o += CPPLESTE_ENV_OBS_PLAYER;
+        o[0] = (float) g.level_index();
+        o[1] = (float) g.freeze;
+        o[2] = (float) g.max_djump;
+        o[3] = (float) g.has_key;
+        o[4] = (float) g.got_fruit;
+        o += CPPLESTE_ENV_OBS_GAME;
+        int slot = 0;
+        for (auto &obj: g.objects) {
+            if (slot == CPPLESTE_ENV_OBS_OBJECTS) {
+                break;
+            }
+            if (obj == nullptr || obj.get() == p) {
+                continue;
+            }
+            o[0] = (float) (obj->type_id + 1);
+            o[1] = (float) obj->x;
+            o[2] = (float) obj->y;
+            o[3] = (float) obj->spr;
+            o += CPPLESTE_ENV_OBS_OBJECT_SIZE;
+            slot++;
+        }
+    }
+
+    void step(int i, int buttons, float *obs, float *rewards, uint8_t *dones, uint8_t *events) {
+        Env &e = envs[i];
+        PICO8<Celeste> &p8 = *e.p8;
+        Celeste &g = p8.game();
+        Celeste::player *p = find_player(g);
+        double y = p != nullptr ? p->y : 0;
+
+        p8.set_btn_state(buttons);
+        p8.step_headless();
+        e.frames++;
+
+        float reward = config.frame_reward;
+        uint8_t event = 0;
+        Celeste::base_obj *q = g.get_player();
+        if (q != nullptr && q->type_id == Celeste::PLAYER_SPAWN) {
+            // only a new room has a player spawn
+            event = CPPLESTE_ENV_EXIT;
+            reward += config.exit_reward;
+        }
+        else if (q == nullptr) {
+            event = CPPLESTE_ENV_DEATH;
+            reward += config.death_reward;
+        }
+        else if (p != nullptr) {
+            reward += config.height_reward * (float) (y - q->y);
+        }
+        if (event == 0 && config.max_frames > 0 && e.frames >= config.max_frames) {
+            event = CPPLESTE_ENV_TIMEOUT;
+        }
+        if (event != 0) {
+            reset(e);
+        }
+
+        if (obs != nullptr) {
+            observe(e, obs + (std::size_t) i * CPPLESTE_ENV_OBS_SIZE);
+        }
+        if (rewards != nullptr) {
+            rewards[i] = reward;
+        }
+        if (dones != nullptr) {
+            dones[i] = event != 0;
+        }
+        if (events != nullptr) {
+            events[i] = event;
+        }
+    }
+};
+
+extern "C" {
+
+int cppleste_env_abi_version(void) {
+    return CPPLESTE_ENV_ABI_VERSION;
+}
+
+void cppleste_env_config_init(cppleste_env_config *config) {
+    config->env_count = 1;
+    config->thread_count = 0;
+    config->room = 0;
+    config->max_frames = 0;
+    config->exit_reward = 1;
+    config->death_reward = -1;
+    config->height_reward = 0;
+    config->frame_reward = 0;
+}
+
+cppleste_env_pool *cppleste_env_pool_create(const cppleste_env_config *config) {
+    if (config == nullptr || config->env_count <= 0 || config->room < 0 || config->room >= 31 ||
+        config->max_frames < 0) {
+        return nullptr;
+    }
+    try {
+        auto *pool = new cppleste_env_pool(*config);
+        cppleste_env_pool_reset(pool, nullptr);
+        return pool;
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void cppleste_env_pool_destroy(cppleste_env_pool *pool) {
+    delete pool;
+}
+
+int cppleste_env_pool_size(const cppleste_env_pool *pool) {
+    return (int) pool->envs.size();
+}
+
+void cppleste_env_pool_reset(cppleste_env_pool *pool, float *obs) {
+    pool->run([=](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            pool->reset(pool->envs[i]);
+            if (obs != nullptr) {
+                cppleste_env_pool::observe(pool->envs[i], obs + (std::size_t) i * CPPLESTE_ENV_OBS_SIZE);
+            }
+        }
+    });
+}
+
+void cppleste_env_pool_step(cppleste_env_pool *pool, const uint8_t *buttons, float *obs, float *rewards,
+                            uint8_t *dones, uint8_t *events) {
+    pool->run([=](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            pool->step(i, buttons[i], obs, rewards, dones, events);
+        }
+    });
+}
+
+}
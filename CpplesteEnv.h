@@ -0,0 +1,83 @@
+#ifndef CPPLESTE_CPPLESTEENV_H
+#define CPPLESTE_CPPLESTEENV_H
+
+// C interface to a pool of Celeste environments, for driving Cppleste from other languages
+// (e.g. python through ctypes/cffi) without per environment call overhead.
+// every call takes flat arrays with one entry (or one row) per environment; all of them are owned by the caller,
+// and are written to directly
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define CPPLESTE_ENV_API __declspec(dllexport)
+#else
+#define CPPLESTE_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bumped whenever a function signature, the config struct or the observation layout changes
+#define CPPLESTE_ENV_ABI_VERSION 1
+
+// observation layout, CPPLESTE_ENV_OBS_SIZE floats per environment:
+//   [0]      1 if the player exists
+//   [1..12]  player x, y, spd x, spd y, rem x, rem y, djump, dash time, grace, on ground, jump held, dash held
+//   [13..17] level index, freeze, max djump, has key, got fruit
+//   [18..]   CPPLESTE_ENV_OBS_OBJECTS objects other than the player, 4 floats each:
+//            type (ObjType + 1, 0 for an empty slot), x, y, sprite
+#define CPPLESTE_ENV_OBS_PLAYER 13
+#define CPPLESTE_ENV_OBS_GAME 5
+#define CPPLESTE_ENV_OBS_OBJECTS 16
+#define CPPLESTE_ENV_OBS_OBJECT_SIZE 4
+#define CPPLESTE_ENV_OBS_SIZE (CPPLESTE_ENV_OBS_PLAYER + CPPLESTE_ENV_OBS_GAME + \
+                               CPPLESTE_ENV_OBS_OBJECTS * CPPLESTE_ENV_OBS_OBJECT_SIZE)
+
+// why an episode ended, written to the events array by cppleste_env_pool_step
+#define CPPLESTE_ENV_EXIT 1
+#define CPPLESTE_ENV_DEATH 2
+#define CPPLESTE_ENV_TIMEOUT 4
+
+typedef struct cppleste_env_config {
+    int env_count;
+    int thread_count; // threads stepping the environments, including the calling one. 0 for one per core
+    int room; // level index every episode starts in
+    int max_frames; // episodes are cut after this many steps, 0 for no limit
+    float exit_reward;
+    float death_reward;
+    float height_reward; // per px the player moved up
+    float frame_reward; // every step, e.g. a small negative number to reward fast exits
+} cppleste_env_config;
+
+typedef struct cppleste_env_pool cppleste_env_pool;
+
+CPPLESTE_ENV_API int cppleste_env_abi_version(void);
+
+// fills config with the defaults: 1 environment, a thread per core, 100m, no frame limit,
+// +1 for exiting, -1 for dying, no shaping
+CPPLESTE_ENV_API void cppleste_env_config_init(cppleste_env_config *config);
+
+// returns NULL if the config is invalid
+CPPLESTE_ENV_API cppleste_env_pool *cppleste_env_pool_create(const cppleste_env_config *config);
+CPPLESTE_ENV_API void cppleste_env_pool_destroy(cppleste_env_pool *pool);
+CPPLESTE_ENV_API int cppleste_env_pool_size(const cppleste_env_pool *pool);
+
+// starts a new episode in every environment. obs may be NULL
+CPPLESTE_ENV_API void cppleste_env_pool_reset(cppleste_env_pool *pool, float *obs);
+
+// advances every environment by one frame, with buttons[i] (a PICO-8 button state, bit 0 left ... bit 5 dash)
+// held in environment i. any of the output arrays may be NULL:
+//   obs     env_count * CPPLESTE_ENV_OBS_SIZE floats
+//   rewards env_count floats
+//   dones   env_count bytes, 1 if the episode ended this step
+//   events  env_count bytes, CPPLESTE_ENV_* flags for why it ended
+// environments whose episode ended are reset right away, and obs holds the first observation of the new episode
+CPPLESTE_ENV_API void cppleste_env_pool_step(cppleste_env_pool *pool, const uint8_t *buttons, float *obs,
+                                             float *rewards, uint8_t *dones, uint8_t *events);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CPPLESTE_CPPLESTEENV_H
@@ -0,0 +1,188 @@
+#ifndef CPPLESTE_DISTANCEFIELD_H
+#define CPPLESTE_DISTANCEFIELD_H
+
+#include <vector>
+#include <deque>
+#include <cmath>
+#include <climits>
+#include "PICO8.h"
+#include "Carts/Celeste.h"
+
+// lower bound on the number of frames it takes the player to exit the room (y < -4) from every position,
+// taking the room's terrain into account
+//
+// computed with a backward search over player positions, where a frame is any move of up to max_dx px
+// horizontally followed by up to max_dy px vertically (the way move() works), through positions where the
+// player's hitbox doesn't overlap solid tiles. this over-approximates what the player can do in a frame, so the
+// bound is admissible:
+// - objects are ignored, so fall floors, fake walls and platforms never block
+// - spikes are passable
+// - the x clamp at the edges of the room and spring launches are free moves
+// - in rooms with platforms, every frame can end with the extra px a platform carries the player
+template<typename Cart=Celeste>
+class DistanceField {
+public:
+    // px per frame. a dash is 5 px/frame, and the subpixel remainder can round that up to 6
+    int max_dx = 6;
+    int max_dy = 6;
+
+    static const int min_x = -7; // the player can move up to 6 px past the x clamp before being put back
+    static const int max_x = 127;
+    static const int min_y = -10; // positions above -4 have exited
+    static const int max_y = 128; // the player dies below that
+    static const int width = max_x - min_x + 1;
+    static const int height = max_y - min_y + 1;
+    static const int unreachable = INT_MAX;
+
+    bool built() const {
+        return !dist.empty();
+    }
+
+    void clear() {
+        dist.clear();
+    }
+
+    // whether the field was built for the room p8 is in
+    bool matches(PICO8<Cart> &p8) const {
+        return built() && room_x == p8.game().room.x && room_y == p8.game().room.y;
+    }
+
+    // frames to exit from (x, y), unreachable if the exit can't be reached from there
+    // returns -1 for positions the field doesn't cover (outside of it, or inside terrain)
+    int at(double px, double py) const {
+        int x = (int) std::floor(px);
+        int y = (int) std::floor(py);
+        if (x < min_x || x > max_x || y < min_y || y > max_y || !free[index(x, y)]) {
+            return -1;
+        }
+        return dist[index(x, y)];
+    }
+
+    // builds the field for the room p8 is in, with the springs currently in it
+    void build(PICO8<Cart> &p8) {
+        Cart &g = p8.game();
+        room_x = g.room.x;
+        room_y = g.room.y;
+
+        free.assign(width * height, false);
+        for (int y = min_y; y <= max_y; y++) {
+            for (int x = min_x; x <= max_x; x++) {
+                // the player's hitbox is (1, 3, 6, 5)
+                free[index(x, y)] = !g.tile_flag_at(x + 1, y + 3, 6, 5, 0);
+            }
+        }
+        springs.clear();
+        int carry = 0;
+        for (auto &o: g.objects) {
+            if (o == nullptr) {
+                continue;
+            }
+            if (o->type_id == Cart::spring::type_enum) {
+                springs.emplace_back((int) o->x, (int) o->y);
+            }
+            else if (o->type_id == Cart::platform::type_enum) {
+                carry = 1;
+            }
+        }
+
+        dist.assign(width * height, unreachable);
+        std::deque<int> queue;
+        for (int y = min_y; y < -4; y++) {
+            for (int x = min_x; x <= max_x; x++) {
+                if (free[index(x, y)]) {
+                    dist[index(x, y)] = 0;
+                    queue.push_back(index(x, y));
+                }
+            }
+        }
+
+        // 0-1 bfs, backwards from the exit
+        std::vector<int> carried, turns;
+        while (!queue.empty()) {
+            int i = queue.front();
+            queue.pop_front();
+            int d = dist[i];
+            int x = i % width + min_x;
+            int y = i / width + min_y;
+
+            auto relax = [&](int j, int nd) {
+                if (nd < dist[j]) {
+                    dist[j] = nd;
+                    if (nd == d) {
+                        queue.push_front(j);
+                    }
+                    else {
+                        queue.push_back(j);
+                    }
+                }
+            };
+
+            // free moves into (x, y): the x clamp, and spring launches
+            if (x == -1 || x == 121) {
+                int lo = x == -1 ? min_x : 122;
+                int hi = x == -1 ? -2 : max_x;
+                for (int cx = lo; cx <= hi; cx++) {
+                    if (free[index(cx, y)]) {
+                        relax(index(cx, y), d);
+                    }
+                }
+            }
+            for (auto &[sx, sy]: springs) {
+                // a spring puts the player at its y - 4 if their hitboxes overlap
+                if (y == sy - 4 && x + 1 < sx + 8 && x + 7 > sx) {
+                    for (int cy = std::max(min_y, sy - 7); cy <= std::min(max_y, sy + 4); cy++) {
+                        if (free[index(x, cy)]) {
+                            relax(index(x, cy), d);
+                        }
+                    }
+                }
+            }
+
+            // a frame ending in (x, y): horizontal, then vertical, then a platform's carry
+            carried.clear();
+            run(x, y, carry, true, [&](int cx, int cy) { carried.push_back(index(cx, cy)); });
+            for (int c: carried) {
+                turns.clear();
+                run(c % width + min_x, c / width + min_y, max_dy, false,
+                    [&](int cx, int cy) { turns.push_back(index(cx, cy)); });
+                for (int t: turns) {
+                    run(t % width + min_x, t / width + min_y, max_dx, true, [&](int cx, int cy) {
+                        if (cy >= -4) {
+                            relax(index(cx, cy), d + 1);
+                        }
+                    });
+                }
+            }
+        }
+    }
+
+protected:
+    int room_x = -1;
+    int room_y = -1;
+    std::vector<bool> free;
+    std::vector<int> dist;
+    std::vector<std::pair<int, int>> springs;
+
+    static int index(int x, int y) {
+        return (y - min_y) * width + (x - min_x);
+    }
+
+    // calls f with (x, y) and every position up to len px away from it along one axis,
+    // that can be reached from it without going through terrain
+    template<typename F>
+    void run(int x, int y, int len, bool horizontal, F f) const {
+        f(x, y);
+        for (int dir = -1; dir <= 1; dir += 2) {
+            for (int k = 1; k <= len; k++) {
+                int cx = horizontal ? x + dir * k : x;
+                int cy = horizontal ? y : y + dir * k;
+                if (cx < min_x || cx > max_x || cy < min_y || cy > max_y || !free[index(cx, cy)]) {
+                    break;
+                }
+                f(cx, cy);
+            }
+        }
+    }
+};
+
+#endif //CPPLESTE_DISTANCEFIELD_H
@@ -0,0 +1,111 @@
+#ifndef CPPLESTE_GENERATOR_H
+#define CPPLESTE_GENERATOR_H
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <utility>
+
+// a lazily produced sequence of values, from a coroutine that co_yields them
+// the coroutine only runs when the sequence is advanced, up to its next co_yield, so the caller can stop
+// reading at any point (destroying the generator destroys the coroutine with it)
+//   for (auto &v: generator) {...}
+template<typename T>
+class Generator {
+public:
+    struct promise_type {
+        T value;
+        std::exception_ptr exception;
+
+        Generator get_return_object() {
+            return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always yield_value(T v) {
+            value = std::move(v);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            exception = std::current_exception();
+        }
+    };
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        T &operator*() const {
+            return handle.promise().value;
+        }
+        T *operator->() const {
+            return &handle.promise().value;
+        }
+        iterator &operator++() {
+            resume(handle);
+            return *this;
+        }
+        void operator++(int) {
+            ++*this;
+        }
+        bool operator==(std::default_sentinel_t) const {
+            return !handle || handle.done();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    explicit Generator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Generator(Generator &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Generator &operator=(Generator &&other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Generator(const Generator &) = delete;
+    Generator &operator=(const Generator &) = delete;
+    ~Generator() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    // runs the coroutine up to its first value. only call once
+    iterator begin() {
+        resume(handle);
+        return iterator(handle);
+    }
+    std::default_sentinel_t end() {
+        return {};
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    // runs up to the next co_yield, and passes on what the coroutine threw
+    static void resume(std::coroutine_handle<promise_type> handle) {
+        if (handle && !handle.done()) {
+            handle.resume();
+            if (handle.promise().exception) {
+                std::rethrow_exception(std::exchange(handle.promise().exception, nullptr));
+            }
+        }
+    }
+};
+
+#endif //CPPLESTE_GENERATOR_H
@@ -6,6 +6,7 @@
 #define CPPLESTE_PICO8_H
 #include <string>
 #include <iostream>
+#include <algorithm>
 using std::string;
 template<typename cart>
 class PICO8 {
@@ -13,6 +14,7 @@ class PICO8 {
     cart _game;
     int map[8192];
     int flags[256];
+    unsigned revision = 0; // changes whenever the map does
 public:
     PICO8():_game(*this){
        btn_state=0;
@@ -31,6 +33,7 @@ public:
         for(int i=0; i<512; i+=2){
             flags[i/2]=std::strtol((string()+_game.flag_data[i]+_game.flag_data[i+1]).c_str(),nullptr,16);
         }
+        revision++;
         _game._init();
     }
     void reset(){
@@ -41,10 +44,21 @@ public:
     }
     void mset(int x, int y, int tile){
         map[x+y*128]=tile;
+        revision++;
+    }
+    // writes a w by h block of tiles, given row by row, with its top left corner at (x, y)
+    void mset_block(int x, int y, int w, int h, const int *tiles){
+        for(int ty=0; ty<h; ty++){
+            std::copy(tiles+ty*w, tiles+(ty+1)*w, map+x+(y+ty)*128);
+        }
+        revision++;
     }
     int mget(int x, int y) const{
         return map[x+y*128];
     }
+    unsigned map_revision() const{
+        return revision;
+    }
     int fget(int n, int f=-1) const{
         int fl=flags[n];
         if(f==-1){
@@ -57,6 +71,10 @@ public:
         _game._update();
         _game._draw();
     }
+    // step without any render-only work, for when nothing looks at the screen
+    void step_headless(){
+        _game._update_headless();
+    }
     void set_inputs(bool l=false,bool r=false,bool u=false,bool d=false,bool z=false,bool x=false){
         set_btn_state(l*1+r*2+u*4+d*8+z*16+x*32);
     }
@@ -0,0 +1,548 @@
+#ifndef CPPLESTE_PROCESSSEARCHELINE_H
+#define CPPLESTE_PROCESSSEARCHELINE_H
+
+#include <vector>
+#include "PICO8.h"
+#include "Carts/Celeste.h"
+#include "CelesteUtils.h"
+#include "Searcheline.h"
+#include <ctime>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <bit>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+
+// fixed size records in a shared memory region, usable by several processes at once
+// (bounded multi-producer multi-consumer queue, every slot carries its own sequence number)
+class SharedRing {
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared rings need lock free atomics");
+    struct alignas(64) Header {
+        std::atomic<std::uint64_t> head;
+        alignas(64) std::atomic<std::uint64_t> tail;
+    };
+    Header *header;
+    char *slots;
+    std::uint64_t capacity;
+    std::size_t record_ints;
+    std::size_t stride;
+
+    std::atomic<std::uint64_t> &seq(std::uint64_t pos) const {
+        return *reinterpret_cast<std::atomic<std::uint64_t> *>(slots + (pos & (capacity - 1)) * stride);
+    }
+    int *payload(std::uint64_t pos) const {
+        return reinterpret_cast<int *>(slots + (pos & (capacity - 1)) * stride + sizeof(std::uint64_t));
+    }
+
+public:
+    // capacity must be a power of 2
+    static std::size_t region_size(std::uint64_t capacity, std::size_t record_ints) {
+        return sizeof(Header) + capacity * slot_stride(record_ints);
+    }
+    static std::size_t slot_stride(std::size_t record_ints) {
+        std::size_t size = sizeof(std::uint64_t) + sizeof(int) * (record_ints + 1);
+        return (size + 7) / 8 * 8;
+    }
+
+    SharedRing() : header(nullptr), slots(nullptr), capacity(0), record_ints(0), stride(0) {}
+
+    // lays out an empty ring at mem
+    SharedRing(void *mem, std::uint64_t capacity, std::size_t record_ints) :
+            header(static_cast<Header *>(mem)),
+            slots(static_cast<char *>(mem) + sizeof(Header)),
+            capacity(capacity),
+            record_ints(record_ints),
+            stride(slot_stride(record_ints)) {
+        if (!std::has_single_bit(capacity)) {
+            throw std::runtime_error("SharedRing: capacity must be a power of 2, got " + std::to_string(capacity));
+        }
+    }
+
+    void reset() {
+        new(&header->head) std::atomic<std::uint64_t>(0);
+        new(&header->tail) std::atomic<std::uint64_t>(0);
+        for (std::uint64_t i = 0; i < capacity; i++) {
+            new(&seq(i)) std::atomic<std::uint64_t>(i);
+        }
+    }
+
+    bool try_push(const std::vector<int> &record) {
+        std::uint64_t pos = header->tail.load(std::memory_order_relaxed);
+        while (true) {
+            std::int64_t diff = (std::int64_t) seq(pos).load(std::memory_order_acquire) - (std::int64_t) pos;
+            if (diff == 0) {
+                if (header->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = header->tail.load(std::memory_order_relaxed);
+            }
+        }
+        int *p = payload(pos);
+        p[0] = record.size();
+        std::memcpy(p + 1, record.data(), record.size() * sizeof(int));
+        seq(pos).store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(std::vector<int> &record) {
+        std::uint64_t pos = header->head.load(std::memory_order_relaxed);
+        while (true) {
+            std::int64_t diff = (std::int64_t) seq(pos).load(std::memory_order_acquire) - (std::int64_t) (pos + 1);
+            if (diff == 0) {
+                if (header->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = header->head.load(std::memory_order_relaxed);
+            }
+        }
+        int *p = payload(pos);
+        record.assign(p + 1, p + 1 + p[0]);
+        seq(pos).store(pos + capacity, std::memory_order_release);
+        return true;
+    }
+};
+
+// the cpus of a sysfs cpu list, e.g. "0-3,8-11"
+inline std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        std::stringstream r(range);
+        int first, last;
+        char dash;
+        if (!(r >> first)) {
+            continue;
+        }
+        if (!(r >> dash >> last)) {
+            last = first;
+        }
+        for (int c = first; c <= last; c++) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+// the cpus of every NUMA node, empty if sysfs doesn't list them
+inline std::vector<std::vector<int>> numa_node_cpus() {
+    std::vector<std::vector<int>> nodes;
+    for (int n = 0;; n++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        std::string list;
+        if (!file || !std::getline(file, list)) {
+            break;
+        }
+        auto cpus = parse_cpu_list(list);
+        if (!cpus.empty()) {
+            nodes.push_back(cpus);
+        }
+    }
+    return nodes;
+}
+
+// runs a Searcheline subclass in several worker processes
+// the coordinator expands the first split_depth levels of every iteration, and hands the
+// subtree roots (as the actions leading to them) to the workers through a shared memory ring.
+// solutions come back through a second ring
+// a crashing worker only loses the subtree it was working on, and the search stops after that depth, since it wasn't
+// searched completely. a worker dying halfway through pushing or popping a record would leave that slot held forever,
+// so the search is aborted instead
+template<typename searchType, typename Cart=Celeste>
+class ProcessSearcheline {
+public:
+    using State = typename Searcheline<Cart>::State;
+
+protected:
+    struct Control {
+        std::atomic<int> producing;
+        std::atomic<int> found;
+    };
+
+    // what a worker is doing, so the coordinator can tell what its crash cost
+    struct WorkerStatus {
+        std::atomic<int> in_ring; // inside a ring operation
+        std::atomic<int> holding; // running a task it popped
+    };
+
+    struct Worker : public searchType {
+        SharedRing *results = nullptr;
+        std::atomic<int> *found = nullptr;
+        WorkerStatus *status = nullptr;
+
+        void report_solution(const std::vector<int> &inputs) override {
+            found->store(1, std::memory_order_relaxed);
+            while (true) {
+                status->in_ring.store(1);
+                bool pushed = results->try_push(inputs);
+                status->in_ring.store(0);
+                if (pushed) {
+                    break;
+                }
+                sched_yield();
+            }
+        }
+
+        void init() {
+            static_cast<Searcheline<Cart> &>(*this).init_state();
+        }
+
+        PICO8<Cart> &pico8() {
+            return this->p8;
+        }
+    };
+
+    int worker_count;
+    int split_depth;
+    bool pin_workers;
+    std::vector<std::vector<int>> numa_nodes; // read when the search starts, if pin_workers
+    std::uint64_t ring_capacity;
+    Worker coordinator;
+    bool verbose = true;
+    bool quiet = false;
+
+    void *region = nullptr;
+    std::size_t region_size = 0;
+    Control *control = nullptr;
+    WorkerStatus *statuses = nullptr;
+    int lost_tasks = 0; // popped by workers that crashed, in the current depth
+    SharedRing tasks;
+    SharedRing results;
+
+    void map_region(int max_depth) {
+        std::size_t record_ints = std::max(max_depth, split_depth) + 2;
+        std::size_t control_size = (sizeof(Control) + worker_count * sizeof(WorkerStatus) + 63) / 64 * 64;
+        std::size_t task_size = SharedRing::region_size(ring_capacity, record_ints);
+        region_size = control_size + task_size + SharedRing::region_size(ring_capacity, record_ints);
+
+        int fd = memfd_create("cppleste-frontier", 0);
+        if (fd >= 0 && ftruncate(fd, region_size) == 0) {
+            region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        else {
+            region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (region == MAP_FAILED) {
+            region = nullptr;
+            throw std::runtime_error("ProcessSearcheline: failed to map shared memory");
+        }
+        char *base = static_cast<char *>(region);
+        control = new(base) Control;
+        statuses = reinterpret_cast<WorkerStatus *>(base + sizeof(Control));
+        tasks = SharedRing(base + control_size, ring_capacity, record_ints);
+        results = SharedRing(base + control_size + task_size, ring_capacity, record_ints);
+    }
+
+    void unmap_region() {
+        if (region) {
+            munmap(region, region_size);
+            region = nullptr;
+        }
+    }
+
+    // task: remaining depth, then the actions leading to the subtree root
+    void run_task(const std::vector<int> &task, const State &root) {
+        State state = root.copy();
+        std::vector<int> inputs;
+        for (std::size_t i = 1; i < task.size(); i++) {
+            auto [new_state, freeze] = coordinator.transition(state, task[i]);
+            inputs.push_back(task[i]);
+            inputs.insert(inputs.end(), freeze, 0);
+            state = std::move(new_state);
+        }
+        coordinator.iddfs(state, task[0], inputs);
+    }
+
+    // a popped task is held until run_task returns. it's marked held before the pop is, so it's never in neither
+    bool pop_task(std::vector<int> &task) {
+        coordinator.status->in_ring.store(1);
+        bool popped = tasks.try_pop(task);
+        if (popped) {
+            coordinator.status->holding.store(1);
+        }
+        coordinator.status->in_ring.store(0);
+        return popped;
+    }
+
+    void run_popped(const std::vector<int> &task, const State &root) {
+        run_task(task, root);
+        coordinator.status->holding.store(0);
+    }
+
+    [[noreturn]] void worker_main(int id, const State &root) {
+        if (pin_workers) {
+            // worker i on the cpus of node i (round robin), so its memory stays local to it
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (!numa_nodes.empty()) {
+                for (int c: numa_nodes[id % numa_nodes.size()]) {
+                    CPU_SET(c, &set);
+                }
+            }
+            else {
+                long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                CPU_SET(id % std::max(cpus, 1L), &set);
+            }
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        coordinator.results = &results;
+        coordinator.found = &control->found;
+        coordinator.status = &statuses[id];
+
+        std::vector<int> task;
+        while (true) {
+            if (pop_task(task)) {
+                run_popped(task, root);
+            }
+            else if (!control->producing.load(std::memory_order_acquire)) {
+                // the producer may have pushed between the failed pop and the load
+                if (!pop_task(task)) {
+                    break;
+                }
+                run_popped(task, root);
+            }
+            else {
+                sched_yield();
+            }
+        }
+        std::cout.flush();
+        _exit(0);
+    }
+
+    void collect(std::vector<int> &record) {
+        while (results.try_pop(record)) {
+            solutions.push_back(record);
+            if (verbose) {
+                std::cout << "  inputs: ";
+                for (auto i: record) {
+                    std::cout << i << ", ";
+                }
+                std::cout << std::endl;
+                std::cout << "  frames: " << record.size() - 1 << std::endl;
+            }
+        }
+    }
+
+    // kills the remaining workers, once a ring can't be used anymore
+    [[noreturn]] void abort_search(std::vector<pid_t> &pids, const std::string &reason) {
+        for (auto pid: pids) {
+            if (pid > 0) {
+                kill(pid, SIGKILL);
+            }
+        }
+        for (auto &pid: pids) {
+            if (pid > 0) {
+                waitpid(pid, nullptr, 0);
+                pid = 0;
+            }
+        }
+        throw std::runtime_error("ProcessSearcheline: " + reason);
+    }
+
+    // reaps exited workers, returns the number still running. counts the tasks crashed workers held in lost_tasks
+    // throws if a worker died inside a ring operation, since waiting on the slot it held would block forever
+    int reap(std::vector<pid_t> &pids) {
+        int alive = 0;
+        for (std::size_t i = 0; i < pids.size(); i++) {
+            if (pids[i] <= 0) {
+                continue;
+            }
+            int status;
+            pid_t r = waitpid(pids[i], &status, WNOHANG);
+            if (r == 0) {
+                alive++;
+            }
+            else {
+                bool held = statuses[i].holding.load();
+                const char *lost = held ? ", its subtree was not searched" : "";
+                if (r == pids[i] && WIFSIGNALED(status)) {
+                    std::cout << "  worker " << i << " crashed (signal " << WTERMSIG(status) << ")" << lost
+                              << std::endl;
+                }
+                else if (r == pids[i] && WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+                    std::cout << "  worker " << i << " exited with status " << WEXITSTATUS(status) << lost
+                              << std::endl;
+                }
+                pids[i] = 0;
+                if (statuses[i].in_ring.load()) {
+                    abort_search(pids, "worker " + std::to_string(i) + " died while using a shared ring");
+                }
+                if (held) {
+                    statuses[i].holding.store(0);
+                    lost_tasks++;
+                }
+            }
+        }
+        return alive;
+    }
+
+    // expands the top levels of the tree, the same way iddfs would, and queues the subtree roots
+    bool produce(const State &state, int depth, std::vector<int> &actions, std::vector<pid_t> &pids,
+                 std::vector<int> &record) {
+        if (depth < 0) {
+            return true;
+        }
+        if (actions.size() == (std::size_t) split_depth || depth == 0) {
+            std::vector<int> task{depth};
+            task.insert(task.end(), actions.begin(), actions.end());
+            while (!tasks.try_push(task)) {
+                collect(record);
+                if (reap(pids) == 0) {
+                    return false;
+                }
+                sched_yield();
+            }
+            return true;
+        }
+        if (coordinator.h_cost(state) > depth) {
+            return true;
+        }
+        for (auto a: coordinator.from_mask(coordinator.search_actions(state))) {
+            auto [new_state, freeze] = coordinator.transition(state, a);
+            actions.push_back(a);
+            bool ok = produce(new_state, depth - 1 - freeze, actions, pids, record);
+            actions.pop_back();
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    std::vector<std::vector<int>> solutions;
+    // the deepest depth the last search searched every subtree of, -1 if none
+    int completed_depth = -1;
+
+    // ring_capacity is rounded up to a power of 2
+    explicit ProcessSearcheline(int worker_count, int split_depth = 4, bool pin_workers = false,
+                                std::uint64_t ring_capacity = 1 << 12) :
+            worker_count(worker_count),
+            split_depth(split_depth),
+            pin_workers(pin_workers),
+            ring_capacity(std::bit_ceil(std::max<std::uint64_t>(ring_capacity, 2))) {}
+
+    ProcessSearcheline(const ProcessSearcheline &) = delete;
+
+    ~ProcessSearcheline() {
+        unmap_region();
+    }
+
+    // whether to print every solution found
+    void set_verbose(bool v) {
+        verbose = v;
+    }
+
+    // don't print the progress of searches (the depths and times). crashed workers, and depths they kept from being
+    // searched completely, are still reported
+    void set_quiet(bool q = true) {
+        quiet = q;
+    }
+
+    std::vector<std::vector<int>> search(int max_depth, bool complete = false) {
+        solutions = std::vector<std::vector<int>>();
+        completed_depth = -1;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        coordinator.init();
+        State state(coordinator.pico8());
+        unmap_region();
+        map_region(max_depth);
+        if (pin_workers) {
+            numa_nodes = numa_node_cpus();
+        }
+
+        if (!quiet) {
+            std::cout << "searching..." << std::endl;
+        }
+        std::vector<int> record;
+        for (int depth = 0; depth <= max_depth; depth++) {
+            if (!quiet) {
+                std::cout << "depth " << depth << "..." << std::endl;
+            }
+
+            tasks.reset();
+            results.reset();
+            control->producing.store(1);
+            control->found.store(0);
+            for (int i = 0; i < worker_count; i++) {
+                new(&statuses[i].in_ring) std::atomic<int>(0);
+                new(&statuses[i].holding) std::atomic<int>(0);
+            }
+            lost_tasks = 0;
+
+            std::cout.flush();
+            std::vector<pid_t> pids;
+            for (int i = 0; i < worker_count; i++) {
+                pid_t pid = fork();
+                if (pid == 0) {
+                    worker_main(i, state);
+                }
+                if (pid < 0) {
+                    std::cout << "  failed to start worker " << i << std::endl;
+                }
+                pids.push_back(pid);
+            }
+
+            std::vector<int> actions;
+            bool ok = produce(state, depth, actions, pids, record);
+            control->producing.store(0, std::memory_order_release);
+            while (reap(pids) > 0) {
+                collect(record);
+                sched_yield();
+            }
+            collect(record);
+            // the workers only exit once the queue is empty, unless they all crashed
+            if (!ok || tasks.try_pop(record)) {
+                std::cout << "  no workers left, depth not fully searched" << std::endl;
+                ok = false;
+            }
+            else if (lost_tasks > 0) {
+                std::cout << "  " << lost_tasks << " subtrees lost to crashed workers, depth not fully searched"
+                          << std::endl;
+                ok = false;
+            }
+            else {
+                completed_depth = depth;
+            }
+
+            bool done = control->found.load() && !complete;
+
+            if (!quiet) {
+                auto t2 = std::chrono::high_resolution_clock::now();
+                std::chrono::duration<double> elapsed_time = t2 - t1;
+                std::cout << "  elapsed time: " << std::fixed << std::setprecision(2) << (elapsed_time.count())
+                          << " [s]" << std::endl;
+            }
+            if (done || !ok) {
+                break;
+            }
+        }
+        return solutions;
+    }
+};
+
+#endif //CPPLESTE_PROCESSSEARCHELINE_H
@@ -0,0 +1,222 @@
+#ifndef CPPLESTE_ROLLOUTEXPLORER_H
+#define CPPLESTE_ROLLOUTEXPLORER_H
+
+#include <vector>
+#include "PICO8.h"
+#include "Carts/Celeste.h"
+#include "Searcheline.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <set>
+#include <cmath>
+#include <cstdint>
+#include <bit>
+
+// monte carlo explorer for rooms too big to search exhaustively
+// plays random rollouts from a search's initial state, picking every input uniformly among the ones get_actions
+// allows, until the goal, a rip (h_cost is infinite) or the horizon. keeps the best states any rollout reached
+// (lowest h_cost) and every goal hit, which gives upper bounds and candidate routes for an exact search
+// searchType is any Searcheline subclass, each thread plays on its own instance of it
+template<typename searchType, typename Cart=Celeste>
+class RolloutExplorer {
+public:
+    using State = typename Searcheline<Cart>::State;
+
+    struct Rollout {
+        std::vector<int> inputs; // button states from the initial state, with 0s for skipped frames
+        double h; // h_cost of the state the inputs lead to, 0 for goals
+        State state;
+    };
+
+    int thread_count;
+    int horizon = 100; // frames per rollout
+    std::size_t keep = 16; // number of best states to keep
+    std::uint64_t seed = 0;
+
+    // of the last explore(). best is sorted by h_cost, then length. goals by length, without duplicates
+    // the states live in the explorer's search instances, and stay valid until the next explore()
+    std::vector<Rollout> best;
+    std::vector<std::vector<int>> goals;
+    long long rollouts = 0;
+    long long frames = 0;
+    double seconds = 0;
+
+    explicit RolloutExplorer(int thread_count) : thread_count(thread_count) {}
+
+    // plays max_rollouts rollouts, or as many as fit in the time limit if seconds is set
+    // rollout i always plays the same inputs for a given seed, no matter the number of threads
+    void explore(long long max_rollouts, double time_limit = 0) {
+        searches.clear();
+        best.clear();
+        goals.clear();
+        rollouts = 0;
+        frames = 0;
+        std::atomic<long long> next_rollout{0};
+        std::atomic<bool> out_of_time{false};
+        std::mutex result_lock;
+        std::set<std::vector<int>> goal_set;
+
+        auto t1 = std::chrono::steady_clock::now();
+        auto deadline = t1 + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(time_limit));
+        std::cout << "exploring..." << std::endl;
+
+        auto work = [&](Searcheline<Cart> &s) {
+            const State root = s.initial_state();
+            std::vector<Rollout> local_best;
+            std::vector<std::vector<int>> local_goals;
+            long long local_frames = 0;
+            long long local_rollouts = 0;
+            State cur, next;
+            std::vector<int> inputs, actions;
+            while (true) {
+                long long i = next_rollout++;
+                if (i >= max_rollouts || out_of_time) {
+                    break;
+                }
+                if (time_limit > 0 && (i & 63) == 0 && std::chrono::steady_clock::now() > deadline) {
+                    out_of_time = true;
+                    break;
+                }
+                std::uint64_t rng = seed ^ mix(i);
+                inputs.clear();
+                actions.clear();
+                cur.assign(root);
+                s.load_state(cur); // search_actions looks at the game, which has to be in cur's state
+                double best_h = s.h_cost(cur);
+                std::size_t best_actions = 0, best_frames = 0;
+                bool goal = false;
+                while ((int) inputs.size() < horizon) {
+                    typename Searcheline<Cart>::action_mask mask = s.search_actions(cur);
+                    if (mask == 0) {
+                        break;
+                    }
+                    rng = mix(rng);
+                    int k = (int) (rng % std::popcount(mask));
+                    for (; k > 0; k--) {
+                        mask &= mask - 1;
+                    }
+                    int a = std::countr_zero(mask);
+                    int freeze = s.transition_into(cur, a, next);
+                    std::swap(cur, next);
+                    actions.push_back(a);
+                    inputs.push_back(a);
+                    inputs.insert(inputs.end(), freeze, 0);
+                    if (s.is_goal(cur)) {
+                        goal = true;
+                        break;
+                    }
+                    double h = s.h_cost(cur);
+                    if (h == HUGE_VAL) {
+                        break;
+                    }
+                    if (h < best_h) {
+                        best_h = h;
+                        best_actions = actions.size();
+                        best_frames = inputs.size();
+                    }
+                }
+                local_frames += inputs.size();
+                local_rollouts++;
+                if (goal) {
+                    local_goals.push_back(inputs);
+                    best_h = 0;
+                    best_actions = actions.size();
+                    best_frames = inputs.size();
+                }
+                if (keep == 0 || (local_best.size() == keep && !better(best_h, best_frames, local_best.back()))) {
+                    continue;
+                }
+                // replay up to the best state of the rollout, only done for the few that make the list
+                Rollout r;
+                r.inputs.assign(inputs.begin(), inputs.begin() + best_frames);
+                r.h = best_h;
+                r.state.assign(root);
+                for (std::size_t j = 0; j < best_actions; j++) {
+                    s.transition_into(r.state, actions[j], next);
+                    std::swap(r.state, next);
+                }
+                insert(local_best, std::move(r));
+            }
+
+            std::lock_guard<std::mutex> lock(result_lock);
+            frames += local_frames;
+            rollouts += local_rollouts;
+            for (auto &r: local_best) {
+                insert(best, std::move(r));
+            }
+            goal_set.insert(local_goals.begin(), local_goals.end());
+        };
+
+        for (int i = 0; i < thread_count; i++) {
+            searches.emplace_back(std::make_unique<searchType>());
+        }
+        std::vector<std::thread> threads;
+        for (auto &s: searches) {
+            threads.emplace_back(work, std::ref<Searcheline<Cart>>(*s));
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+
+        goals.assign(goal_set.begin(), goal_set.end());
+        std::stable_sort(goals.begin(), goals.end(), [](const std::vector<int> &a, const std::vector<int> &b) {
+            return a.size() < b.size();
+        });
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+        std::cout << "  rollouts: " << rollouts << " (" << std::fixed << std::setprecision(0)
+                  << rollouts_per_second() << "/s)" << std::endl;
+        if (!best.empty()) {
+            std::cout << "  best h: " << std::setprecision(2) << best.front().h << " after "
+                      << best.front().inputs.size() << " frames" << std::endl;
+        }
+        if (!goals.empty()) {
+            std::cout << "  goals: " << goals.size() << ", shortest " << goals.front().size() << " frames" << std::endl;
+        }
+        std::cout << "  elapsed time: " << std::fixed << std::setprecision(2) << seconds << " [s]" << std::endl;
+    }
+
+    double rollouts_per_second() const {
+        return seconds > 0 ? rollouts / seconds : 0;
+    }
+
+protected:
+    std::vector<std::unique_ptr<searchType>> searches;
+
+    static std::uint64_t mix(std::uint64_t x) {
+        // splitmix64
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    static bool better(double h, std::size_t length, const Rollout &r) {
+        return h < r.h || (h == r.h && length < r.inputs.size());
+    }
+
+    // inserts r into the sorted list, keeping at most keep entries
+    // rollouts that share a prefix often reach the same best state, only the first is kept
+    void insert(std::vector<Rollout> &list, Rollout &&r) {
+        for (auto &o: list) {
+            if (o.inputs == r.inputs) {
+                return;
+            }
+        }
+        auto it = std::find_if(list.begin(), list.end(), [&](const Rollout &o) {
+            return better(r.h, r.inputs.size(), o);
+        });
+        list.insert(it, std::move(r));
+        if (list.size() > keep) {
+            list.pop_back();
+        }
+    }
+};
+
+#endif //CPPLESTE_ROLLOUTEXPLORER_H
@@ -0,0 +1,219 @@
+#ifndef CPPLESTE_ROOMBATCH_H
+#define CPPLESTE_ROOMBATCH_H
+
+#include <vector>
+#include "PICO8.h"
+#include "Carts/Celeste.h"
+#include "CelesteUtils.h"
+#include "Searcheline.h"
+#include <string>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <iomanip>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <cctype>
+#include <stdexcept>
+
+struct RoomResult {
+    std::size_t room = 0; // index of the room among the rooms read
+    int frames = -1; // of the shortest solution, counted like searcheline prints them. -1 if none was found
+    long long solutions = 0; // solutions found, of every length searched
+    long long nodes = 0;
+    double seconds = 0;
+    std::vector<int> inputs; // a shortest solution, if the search kept it
+};
+
+// searches many variants of one room on several threads, e.g. to get the optimal frame count of generated rooms
+// rooms are read from a stream in the utils::replace_room format: 256 tile characters each, row by row.
+// whitespace is ignored, a room has to end at a line break, and lines starting with # are skipped
+// every thread has its own instance of searchType, whose init_state should load level_id. each room's tiles are
+// written over that level right before its search, so only the room's objects and terrain are rebuilt between rooms
+template<typename searchType, typename Cart=Celeste>
+class RoomBatch {
+public:
+    using Configure = std::function<void(searchType &)>;
+
+    int thread_count;
+    int level_id;
+    int max_depth;
+    bool complete = false; // search every depth up to max_depth, instead of stopping at the first with solutions
+    Configure configure; // called on each search instance before its first room, e.g. to count solutions instead
+
+    // of the last run
+    std::size_t rooms = 0;
+    long long nodes = 0;
+    double seconds = 0;
+
+    RoomBatch(int thread_count, int level_id, int max_depth, Configure configure = nullptr) :
+            thread_count(thread_count),
+            level_id(level_id),
+            max_depth(max_depth),
+            configure(configure) {}
+
+    RoomResult evaluate(searchType &s, const utils::room_tiles &tiles) const {
+        RoomResult r;
+        utils::apply_room(s.pico8(), level_id, tiles);
+        auto t1 = std::chrono::steady_clock::now();
+        std::vector<std::vector<int>> sols = s.search(max_depth, complete);
+        r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+        r.nodes = s.node_count();
+        const std::vector<long long> &counts = s.solution_counts();
+        for (std::size_t length = 0; length < counts.size(); length++) {
+            if (counts[length] > 0 && r.frames == -1) {
+                r.frames = (int) length - 1;
+            }
+            r.solutions += counts[length];
+        }
+        for (auto &sol: sols) {
+            if ((int) sol.size() == r.frames + 1) {
+                r.inputs = sol;
+                break;
+            }
+        }
+        return r;
+    }
+
+    // searches every room in the stream. rooms are read as the threads need them, and if out is given, a line
+    // per room is written to it as soon as its search is done (see write), so in the order they finish
+    // the returned results are in input order
+    std::vector<RoomResult> run(std::istream &in, std::ostream *out = nullptr) {
+        std::mutex read_lock;
+        std::mutex result_lock;
+        std::size_t next_index = 0;
+        std::vector<RoomResult> results;
+        nodes = 0;
+        std::string error;
+
+        auto t1 = std::chrono::steady_clock::now();
+        auto work = [&]() {
+            auto s = std::make_unique<searchType>();
+            s->set_quiet();
+            s->set_verbose(false);
+            if (configure) {
+                configure(*s);
+            }
+            std::string room;
+            while (true) {
+                std::size_t index;
+                {
+                    std::lock_guard<std::mutex> lock(read_lock);
+                    if (!error.empty()) {
+                        break;
+                    }
+                    try {
+                        if (!read_room(in, room)) {
+                            break;
+                        }
+                    }
+                    catch (const std::exception &e) {
+                        error = e.what();
+                        break;
+                    }
+                    index = next_index++;
+                }
+                RoomResult r;
+                try {
+                    r = evaluate(*s, utils::decode_room(room));
+                }
+                catch (const std::exception &e) {
+                    std::lock_guard<std::mutex> lock(read_lock);
+                    error = "room " + std::to_string(index) + ": " + e.what();
+                    break;
+                }
+                r.room = index;
+                std::lock_guard<std::mutex> lock(result_lock);
+                nodes += r.nodes;
+                if (out != nullptr) {
+                    write(*out, r);
+                    out->flush();
+                }
+                results.push_back(std::move(r));
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++) {
+            threads.emplace_back(work);
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+        rooms = results.size();
+
+        std::sort(results.begin(), results.end(), [](const RoomResult &a, const RoomResult &b) {
+            return a.room < b.room;
+        });
+        return results;
+    }
+
+    // reads the rooms from in_path, and writes the result lines to out_path if it's not empty
+    std::vector<RoomResult> run_file(const std::string &in_path, const std::string &out_path = "") {
+        std::ifstream in(in_path);
+        if (!in) {
+            throw std::runtime_error("can't open " + in_path);
+        }
+        if (out_path.empty()) {
+            return run(in);
+        }
+        std::ofstream out(out_path);
+        if (!out) {
+            throw std::runtime_error("can't open " + out_path);
+        }
+        return run(in, &out);
+    }
+
+    // "room frames solutions nodes seconds; inputs", inputs comma separated like searcheline prints them
+    static void write(std::ostream &out, const RoomResult &r) {
+        out << r.room << " " << r.frames << " " << r.solutions << " " << r.nodes << " " << std::fixed
+            << std::setprecision(3) << r.seconds << ";";
+        for (std::size_t i = 0; i < r.inputs.size(); i++) {
+            out << (i == 0 ? " " : ", ") << r.inputs[i];
+        }
+        out << "\n";
+    }
+
+    double rooms_per_second() const {
+        return seconds > 0 ? rooms / seconds : 0;
+    }
+
+private:
+    // the lines of the next room in in, false at the end of the stream
+    static bool read_room(std::istream &in, std::string &room) {
+        room.clear();
+        std::size_t tiles = 0;
+        std::string line;
+        while (std::getline(in, line)) {
+            auto first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#') {
+                continue;
+            }
+            tiles += std::count_if(line.begin(), line.end(), [](char c) {
+                return !std::isspace((unsigned char) c);
+            });
+            room += line;
+            room += '\n';
+            if (tiles == 256) {
+                return true;
+            }
+            if (tiles > 256) {
+                throw std::runtime_error("room data doesn't end at a line break: " + line);
+            }
+        }
+        if (tiles > 0) {
+            throw std::runtime_error("the last room only has " + std::to_string(tiles) + " tiles");
+        }
+        return false;
+    }
+};
+
+#endif //CPPLESTE_ROOMBATCH_H
@@ -9,14 +9,221 @@
 #include "PICO8.h"
 #include "Carts/Celeste.h"
 #include "CelesteUtils.h"
+#include "DistanceField.h"
+#include "Generator.h"
 #include <tuple>
 #include <ctime>
 #include <iostream>
 #include <iomanip>
 #include <chrono>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <stdexcept>
+#include <cstdint>
+#include <bit>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 int count = 0;
 
+// lets a running search be stopped, from another thread or by the search itself
+// cheap to check: stopped() is a single relaxed load
+struct CancellationToken {
+    enum Reason {NONE, FIRST_SOLUTION, CANCELLED, DEADLINE, NODE_LIMIT};
+    bool stop_at_first = false; // stop once a solution is found
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    long long node_limit = 0; // 0 for no limit
+
+    void reset() {
+        status.store(NONE);
+        spent.store(0);
+    }
+    // only the first reason given is kept
+    void stop(Reason reason) {
+        int expected = NONE;
+        status.compare_exchange_strong(expected, reason);
+    }
+    bool stopped() const {
+        return status.load(std::memory_order_relaxed) != NONE;
+    }
+    Reason reason() const {
+        return Reason(status.load());
+    }
+    bool past_deadline() const {
+        return std::chrono::steady_clock::now() >= deadline;
+    }
+    // adds n nodes to the ones expanded by every thread, returns whether that reaches the node limit
+    bool spend(long long n) {
+        return node_limit > 0 && spent.fetch_add(n, std::memory_order_relaxed) + n >= node_limit;
+    }
+private:
+    std::atomic<int> status{NONE};
+    std::atomic<long long> spent{0};
+};
+
+// what a search got through, also filled in when it was stopped early
+struct SearchStats {
+    long long nodes = 0;
+    int depth = -1; // depth being searched when the search ended
+    int completed_depth = -1; // deepest depth that was searched to the end
+    std::size_t solution_count = 0;
+    CancellationToken::Reason stop_reason = CancellationToken::NONE;
+    double seconds = 0;
+    // the expanded node closest to the goal by h_cost, and the inputs that lead to it. what a search that ran out
+    // of budget without a solution got closest to
+    double best_h = HUGE_VAL;
+    std::vector<int> best_inputs;
+};
+
+// what Searcheline::search_stream yields: a solution as soon as it's found, and the end of every depth
+struct SearchEvent {
+    enum Kind {SOLUTION, DEPTH_DONE};
+    Kind kind = SOLUTION;
+    int depth = 0; // depth being searched
+    std::vector<int> inputs; // the solution, empty for DEPTH_DONE
+    long long solutions = 0; // DEPTH_DONE only: number of solutions of this depth
+    long long nodes = 0; // nodes expanded so far
+};
+
+// where a search puts the solutions it finds
+// STORE keeps every solution, COUNT only counts them (keeping a random sample of sample_size of them),
+// STREAM writes them to a file as they're found. all modes count the solutions of each length
+struct SolutionSink {
+    enum Mode {STORE, COUNT, STREAM};
+    Mode mode = STORE;
+    bool verbose = true; // print every solution
+    std::size_t sample_size = 0;
+    std::uint64_t seed = 0;
+    std::vector<long long> counts; // number of solutions of each length
+    long long total = 0;
+    std::string stream_path;
+    std::ofstream stream;
+
+    // stream file: an 8 byte header, then for every solution its length as a LEB128 varint,
+    // followed by one byte per input
+    static constexpr char stream_header[8] = {'c', 'p', 'l', 's', 's', 'o', 'l', 1};
+
+    void reset() {
+        counts.clear();
+        total = 0;
+    }
+
+    // opens the stream file, if streaming. keep_size is the number of bytes to keep from an earlier run
+    void open(std::uintmax_t keep_size = 0) {
+        if (mode != STREAM) {
+            return;
+        }
+        stream.close();
+        if (keep_size > 0) {
+            std::filesystem::resize_file(stream_path, keep_size);
+            stream.open(stream_path, std::ios::binary | std::ios::app);
+        }
+        else {
+            stream.open(stream_path, std::ios::binary | std::ios::trunc);
+            stream.write(stream_header, sizeof(stream_header));
+        }
+        if (!stream) {
+            throw std::runtime_error("can't write " + stream_path);
+        }
+    }
+
+    // number of bytes written to the stream so far
+    std::uintmax_t stream_size() {
+        if (mode != STREAM || !stream.is_open()) {
+            return 0;
+        }
+        stream.flush();
+        return stream.tellp();
+    }
+
+    void add(const std::vector<int> &inputs, std::vector<std::vector<int>> &kept) {
+        if (counts.size() <= inputs.size()) {
+            counts.resize(inputs.size() + 1);
+        }
+        counts[inputs.size()]++;
+        total++;
+        if (mode == STORE) {
+            kept.push_back(inputs);
+        }
+        else if (mode == COUNT && sample_size > 0) {
+            // reservoir sampling, with the random index derived from the solution's number so it survives resuming
+            if (kept.size() < sample_size) {
+                kept.push_back(inputs);
+            }
+            else {
+                std::uint64_t j = mix(seed + total) % total;
+                if (j < sample_size) {
+                    kept[j] = inputs;
+                }
+            }
+        }
+        else if (mode == STREAM) {
+            std::size_t n = inputs.size();
+            do {
+                stream.put(char((n & 0x7f) | (n > 0x7f ? 0x80 : 0)));
+                n >>= 7;
+            } while (n > 0);
+            for (auto i: inputs) {
+                stream.put(char(i));
+            }
+        }
+        if (verbose) {
+            std::cout << "  inputs: ";
+            for (auto i: inputs) {
+                std::cout << i << ", ";
+            }
+            std::cout << std::endl;
+            std::cout << "  frames: " << inputs.size() - 1 << std::endl;
+        }
+    }
+
+    // calls f with every solution in a stream file
+    static void read_stream(const std::string &path, const std::function<void(const std::vector<int> &)> &f) {
+        std::ifstream in(path, std::ios::binary);
+        char header[sizeof(stream_header)];
+        if (!in.read(header, sizeof(header)) || !std::equal(header, header + sizeof(header), stream_header)) {
+            throw std::runtime_error("not a solution stream: " + path);
+        }
+        std::vector<int> inputs;
+        while (in.peek() != EOF) {
+            std::size_t n = 0;
+            int shift = 0;
+            int c;
+            do {
+                c = in.get();
+                if (c == EOF) {
+                    throw std::runtime_error("truncated solution stream: " + path);
+                }
+                n |= std::size_t(c & 0x7f) << shift;
+                shift += 7;
+            } while (c & 0x80);
+            inputs.resize(n);
+            for (auto &i: inputs) {
+                i = in.get();
+            }
+            if (!in) {
+                throw std::runtime_error("truncated solution stream: " + path);
+            }
+            f(inputs);
+        }
+    }
+
+private:
+    static std::uint64_t mix(std::uint64_t x) {
+        // splitmix64
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+};
+
 template<typename Cart=Celeste>
 class Searcheline {
 protected:
@@ -24,7 +231,11 @@ protected:
     PICO8<Cart> p8;
     std::vector<std::vector<int>> solutions;
 public:
+    // set of actions, bit a is set if button state a is allowed
+    using action_mask = std::uint64_t;
     struct State;
+    SearchStats stats; // of the last search, partial if it ran out of budget
+
     explicit Searcheline() {
         utils::enable_loop_mode(p8);
     };
@@ -34,23 +245,75 @@ public:
     virtual std::vector<int>
     allowable_actions(const State &state, typename Cart::player &player, bool h_movement, bool can_jump,
                       bool can_dash) {
-        std::vector<int> actions{0b000000};
-        if (h_movement) {
-            actions.insert(actions.end(), {0b000001, 0b000010});
+        default_allowable_actions_ran = true;
+        return from_mask(default_action_mask(h_movement, can_jump, can_dash));
+    }
+
+    // the same as allowable_actions, as a mask. this is what the search uses, override it instead of
+    // allowable_actions to avoid building a vector for every node
+    // the default only calls allowable_actions if a subclass overrides it, see custom_allowable_actions
+    virtual action_mask
+    allowable_action_mask(const State &state, typename Cart::player &player, bool h_movement, bool can_jump,
+                          bool can_dash) {
+        if (custom_allowable_actions < 0) {
+            default_allowable_actions_ran = false;
+            action_mask mask = to_mask(allowable_actions(state, player, h_movement, can_jump, can_dash));
+            custom_allowable_actions =
+                    !default_allowable_actions_ran || mask != default_action_mask(h_movement, can_jump, can_dash);
+            return mask;
         }
-        if (can_jump) {
-            actions.insert(actions.end(), {0b010000});
-            if (h_movement) {
-                actions.insert(actions.end(), {0b010001, 0b010010});
+        if (custom_allowable_actions) {
+            return to_mask(allowable_actions(state, player, h_movement, can_jump, can_dash));
+        }
+        return default_action_mask(h_movement, can_jump, can_dash);
+    }
+
+    // every action, less the ones the checks rule out
+    static action_mask default_action_mask(bool h_movement, bool can_jump, bool can_dash) {
+        auto bits = [](std::initializer_list<int> actions) {
+            action_mask mask = 0;
+            for (auto a: actions) {
+                mask |= action_mask(1) << a;
             }
+            return mask;
+        };
+        static const action_mask still = bits({0b000000});
+        static const action_mask move = bits({0b000001, 0b000010});
+        static const action_mask jump = bits({0b010000});
+        static const action_mask jump_move = bits({0b010001, 0b010010});
+        static const action_mask dash = bits({0b100000, 0b100001, 0b100010, 0b100100, 0b100101, 0b100110, 0b101000,
+                                              0b101001, 0b101010});
+        return still | (h_movement ? move : 0) | (can_jump ? jump : 0) | (can_jump && h_movement ? jump_move : 0) |
+               (can_dash ? dash : 0);
+    }
+
+    static action_mask to_mask(const std::vector<int> &actions) {
+        action_mask mask = 0;
+        for (auto a: actions) {
+            mask |= action_mask(1) << a;
         }
-        if (can_dash) {
-            actions.insert(actions.end(),
-                           {0b100000, 0b100001, 0b100010, 0b100100, 0b100101, 0b100110, 0b101000, 0b101001, 0b101010});
+        return mask;
+    }
+
+    static std::vector<int> from_mask(action_mask mask) {
+        std::vector<int> actions;
+        for (; mask; mask &= mask - 1) {
+            actions.push_back(std::countr_zero(mask));
         }
         return actions;
     }
 
+    // score of trying action a from parent, which led to child. children with lower scores are searched first
+    // frame is the index of a in the inputs, h is h_cost(child) (0 for goals)
+    // must only depend on its arguments and the search settings, otherwise resuming from a checkpoint breaks
+    virtual double move_score(const State &parent, const State &child, int a, double h, std::size_t frame) {
+        if (learned_ordering && frame < action_prior.size() && prior_total[frame] > 0) {
+            // break ties in favour of the actions earlier solutions took at this frame
+            return h - double(action_prior[frame][a]) / (prior_total[frame] + 1);
+        }
+        return h;
+    }
+
     virtual double h_cost(const State &state) {
         if (is_rip(state)) {
             return HUGE_VAL;
@@ -60,6 +323,28 @@ public:
         }
     }
 
+    // drop-in replacement for h_cost, which also takes the room's terrain into account (see DistanceField.h)
+    // the field is built for the room of the first state it's called with. outside of it, or if the player has
+    // left that room, falls back to exit_heuristic
+    double distance_h_cost(const State &state) {
+        if (is_rip(state)) {
+            return HUGE_VAL;
+        }
+        const typename Cart::player &player = *find_player(state.objects);
+        double h = exit_heuristic(player);
+        if (!distance_field.built()) {
+            distance_field.build(p8);
+        }
+        if (!distance_field.matches(p8)) {
+            return h;
+        }
+        int d = distance_field.at(player.x, player.y);
+        if (d == DistanceField<Cart>::unreachable) {
+            return HUGE_VAL;
+        }
+        return std::max(h, (double) d);
+    }
+
     virtual bool is_rip(const State &state) {
         return find_player(state.objects) == nullptr;
     }
@@ -73,18 +358,55 @@ public:
         return find_player_spawn(state.objects) != nullptr;
     }
 
-    virtual std::vector<int> get_actions(const State& state) {
+    // macro mode: a hold ends as soon as this changes. called right after the transition into state
+    // **Default**: whether the player is on the ground, touching a wall, and has a dash
+    virtual unsigned macro_features(const State &state) {
+        typename Cart::player *p = find_player(state.objects);
+        if (p == nullptr) {
+            return 0;
+        }
+        unsigned ground = p->is_solid(0, 1);
+        unsigned wall = p->is_solid(-3, 0) || p->is_solid(3, 0);
+        unsigned dash = p->djump > 0;
+        return ground | wall << 1 | dash << 2;
+    }
+
+    virtual action_mask get_action_mask(const State& state) {
         typename Cart::player *p = find_player(state.objects);
         if (p == nullptr) {
-            return {};
+            return 0;
         }
         if (p->dash_time != 0) {
-            return {0b0000000};
+            return 1;
         }
         bool h_movement, can_jump, can_dash;
         std::tie(h_movement, can_jump, can_dash) = action_restrictions(state, *p);
-        return allowable_actions(state, *p, h_movement, can_jump, can_dash);
+        return allowable_action_mask(state, *p, h_movement, can_jump, can_dash);
+    }
+
+    // the same as get_action_mask, as a list. override it to pick the inputs from the whole state without the
+    // checks above, the search then calls it for every node (see search_actions)
+    virtual std::vector<int> get_actions(const State& state) {
+        default_get_actions_ran = true;
+        return from_mask(get_action_mask(state));
+    }
 
+    // the inputs the search tries from state: get_actions if a subclass overrides it, get_action_mask otherwise
+    action_mask search_actions(const State &state) {
+        if (custom_get_actions < 0) {
+            default_get_actions_ran = false;
+            action_mask mask = to_mask(get_actions(state));
+            custom_get_actions = !default_get_actions_ran || mask != get_action_mask(state);
+            return mask;
+        }
+        return custom_get_actions ? to_mask(get_actions(state)) : get_action_mask(state);
+    }
+
+    // the state searches start from, as set up by init_state. the game is left in that state
+    State initial_state() {
+        distance_field.clear();
+        init_state();
+        return State(p8);
     }
 
     static objlist deepcopy(const objlist &objs) {
@@ -94,21 +416,91 @@ public:
         }
         return cp;
     }
+
+    // makes dst a copy of src, reusing the objects already in dst where the types line up
+    // only allocates when the object set changed (e.g. an object was created or destroyed)
+    static void copy_objects(objlist &dst, const objlist &src) {
+        Cart::copy_objects(dst, src);
+    }
+
+    // the objects of a state. states share the objects that didn't change between them,
+    // so once in a state an object must not be modified
+    using shared_objlist = std::vector<std::shared_ptr<typename Cart::base_obj>>;
+
+    // makes dst a copy of src, skipping the objects dst already has in the same state
+    static void copy_objects(objlist &dst, const shared_objlist &src) {
+        auto d = dst.begin();
+        for (auto &o: src) {
+            if (d != dst.end() && *d != nullptr && (*d)->type_id == o->type_id) {
+                if (!(*d)->equals(*o)) {
+                    (*d)->copy_from(*o);
+                }
+                d++;
+            }
+            else {
+                dst.emplace(d, o->clone());
+            }
+        }
+        dst.erase(d, dst.end());
+    }
+
     struct State{
         int max_djump;
         bool has_dashed;
         bool has_key;
         bool got_fruit;
-        objlist objects;
+        shared_objlist objects;
         explicit State(PICO8<Cart> &p8){
+            assign(p8);
+        }
+        State() = default;
+        // like State(p8), but reuses this state's objects. objects in the same state as the one at the same
+        // position in parent are shared with it instead of copied
+        void assign(PICO8<Cart> &p8, const State *parent = nullptr){
             max_djump=p8.game().max_djump;
             has_dashed=p8.game().has_dashed;
             has_key=p8.game().has_key;
             got_fruit=p8.game().got_fruit | p8.game().prev_got_fruit; // continue being correct even if the level has cleared
-            objects=deepcopy(p8.game().objects);
+            const objlist &src = p8.game().objects;
+            objects.resize(src.size());
+            std::size_t i = 0;
+            for (auto &o: src) {
+                auto &dst = objects[i];
+                const auto *shared = parent != nullptr && i < parent->objects.size() ? &parent->objects[i] : nullptr;
+                if (shared != nullptr && (*shared)->type_id == o->type_id && (*shared)->equals(*o)) {
+                    if (dst != *shared) {
+                        dst = *shared;
+                    }
+                }
+                else if (dst != nullptr && dst.use_count() == 1 && dst->type_id == o->type_id) {
+                    // nothing else sees it, so it can be overwritten. the fence orders this after whatever
+                    // another thread did with it before letting go of it
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    dst->copy_from(*o);
+                }
+                else {
+                    dst.reset(o->clone());
+                }
+                i++;
+            }
         }
-        State() = default;
-        State copy(){
+        void assign(const State &other){
+            max_djump=other.max_djump;
+            has_dashed=other.has_dashed;
+            has_key=other.has_key;
+            got_fruit=other.got_fruit;
+            objects=other.objects;
+        }
+        // gives the state its own copies of its objects, pointing at the game of p8
+        // needed before a state made with another PICO8 instance (e.g. by another thread) is searched
+        void bind(PICO8<Cart> &p8){
+            for (auto &o: objects) {
+                o.reset(o->clone());
+                o->p8 = std::ref(p8);
+                o->g = std::ref(p8.game());
+            }
+        }
+        State copy() const{
             //the copy constructor should be implicitely deleted
             //but for some reason it's not
             //or at least, explicitly deleting it calls errors
@@ -119,7 +511,7 @@ public:
             other.has_dashed=has_dashed;
             other.has_key=has_key;
             other.got_fruit=got_fruit;
-            other.objects=deepcopy(objects);
+            other.objects=objects;
             return other;
         }
     };
@@ -129,92 +521,835 @@ public:
         p8.game().has_key=state.has_key;
         p8.game().got_fruit=state.got_fruit;
         p8.game().prev_got_fruit=false; //assume we don't care about loading states after level transitions
-        p8.game().objects=deepcopy(state.objects);
+        copy_objects(p8.game().objects, state.objects);
+        p8.game().refresh_present();
     }
 
-    std::tuple<State, int> transition(const State &state, int a) {
+    // writes the state after taking action a into out, returns the number of frames skipped
+    int transition_into(const State &state, int a, State &out) {
         load_state(state);
         p8.set_btn_state(a);
-        p8.step();
+        p8.step_headless();
         int freeze=p8.game().freeze;
         p8.game().freeze = 0;
 
         //skip pause_player frames
         int pause=0;
         while(p8.game().pause_player){
-            p8.step();
+            p8.step_headless();
             pause++;
         }
 
         p8.game().delay_restart = 0;
-        return std::make_tuple(State(p8),freeze+pause);
+        out.assign(p8, &state);
+        return freeze+pause;
     }
 
-    bool iddfs(const State &state, int depth, std::vector<int> &inputs) {
-        //std::cout<<"in";
-        if (depth == 0 && is_goal(state)) {
-            solutions.push_back(inputs);
-            std::cout << "  inputs: ";
-            for (auto i: inputs) {
-                std::cout << i << ", ";
+    std::tuple<State, int> transition(const State &state, int a) {
+        State out;
+        int freeze = transition_into(state, a, out);
+        return std::make_tuple(std::move(out), freeze);
+    }
+
+    // called by iddfs for every solution found
+    // override to redirect solutions somewhere other than the solutions list
+    virtual void report_solution(const std::vector<int> &inputs) {
+        sink.add(inputs, solutions);
+    }
+
+    // only count solutions instead of keeping them, solutions() then returns a random sample of sample_size of them
+    void count_solutions(std::size_t sample_size = 0, std::uint64_t seed = 0) {
+        sink.mode = SolutionSink::COUNT;
+        sink.sample_size = sample_size;
+        sink.seed = seed;
+    }
+
+    // write solutions to path as they're found, instead of keeping them. see SolutionSink::read_stream
+    void stream_solutions(const std::string &path) {
+        sink.mode = SolutionSink::STREAM;
+        sink.stream_path = path;
+    }
+
+    // whether to print every solution found
+    void set_verbose(bool verbose) {
+        sink.verbose = verbose;
+    }
+
+    // number of solutions found of each length
+    const std::vector<long long> &solution_counts() const {
+        return sink.counts;
+    }
+
+    // don't print the progress of searches (the depths and times), e.g. when running many at once
+    void set_quiet(bool q = true) {
+        quiet = q;
+    }
+
+    // skip the depths that can't search anything new (on by default). that needs h_cost at the leaves too, turn it
+    // off when h_cost is expensive and the depths the search needs are rarely skipped
+    void set_depth_jumping(bool on = true) {
+        depth_jumping = on;
+    }
+
+    // nodes expanded by the last search
+    long long node_count() const {
+        return nodes;
+    }
+
+    // stop searches after this many seconds, 0 for no limit. the search then returns the solutions found so far,
+    // and stats has the deepest depth that was searched completely and the closest the search got to the goal
+    // a search stopped with checkpoints enabled writes one first, so resume can continue it
+    void set_time_limit(double seconds) {
+        time_limit = seconds;
+    }
+
+    // stop searches after expanding this many nodes, 0 for no limit. see set_time_limit
+    void set_node_limit(long long limit) {
+        budget.node_limit = limit;
+    }
+
+    // the emulator the search runs on, e.g. to change the map before a search
+    PICO8<Cart> &pico8() {
+        return p8;
+    }
+
+protected:
+    SolutionSink sink;
+    DistanceField<Cart> distance_field;
+
+    // a child of an expanded node. it's evaluated right after the transition that produced it,
+    // while the game's objects are still the child's
+    struct Child {
+        State state;
+        int action;
+        int freeze;
+        bool goal;
+        action_mask actions; // empty unless there's depth left and the heuristic allows reaching the goal
+        double h; // as returned by evaluate
+        double score;
+        // macro mode only (see set_hold_lengths)
+        std::vector<int> inputs; // every frame of the macro that led here, empty for single frame children
+        unsigned features; // macro_features of the state
+        bool fine; // the macro was cut short by an event, so this child branches frame by frame
+        // the action the macro held and for how many transitions in a row, counting the holds of it right before
+        // -1 if it was cut short or isn't a macro, as the run can't continue then
+        int run_action;
+        int run_length;
+    };
+    // one level of the explicit search stack
+    // frames above the top of the stack are kept around, so their states and child slots are reused
+    struct Frame {
+        State state;
+        int depth; // remaining depth
+        std::vector<Child> children; // slots for the children, the first count are in use
+        std::size_t count;
+        std::vector<std::uint16_t> order; // children to search, best first
+        std::size_t next; // number of children already searched
+        int pushed; // number of inputs added when entering this node
+        unsigned features;
+        bool fine;
+        int run_action;
+        int run_length;
+    };
+    std::vector<Frame> stack;
+    std::size_t height = 0; // number of frames in use
+    long long nodes = 0;
+    long long goals = 0; // solutions reported, so a caller of advance can tell a step found one
+
+    // progress of the current search(), as written to checkpoints
+    int iteration_depth = 0;
+    int search_max_depth = 0;
+    bool search_complete = false;
+    bool iteration_found = false;
+    bool first_only = false;
+    bool quiet = false;
+    bool depth_jumping = true;
+
+    // whether a subclass overrides get_actions and allowable_actions, -1 until the first call finds out (the default
+    // versions mark that they ran). an override that returns what the default one does on that call counts as the
+    // default
+    int custom_get_actions = -1;
+    int custom_allowable_actions = -1;
+    bool default_get_actions_ran = false;
+    bool default_allowable_actions_ran = false;
+
+    // IDA* style bound: the least a node cut off in the current iteration needed the depth to grow by to be searched
+    // further. every depth in between is bound to search the same nodes, and find nothing new
+    int min_excess = std::numeric_limits<int>::max();
+
+    // budgets. they're only checked once nodes reaches budget_check, so advance just compares two numbers
+    CancellationToken budget;
+    double time_limit = 0;
+    long long budget_check = std::numeric_limits<long long>::max();
+
+    std::string checkpoint_path;
+    double checkpoint_interval = 0;
+    bool checkpointing = false;
+    std::chrono::steady_clock::time_point last_checkpoint;
+
+    // move ordering learned from earlier solutions: how often each action was taken at each frame
+    bool learned_ordering = false;
+    std::vector<std::vector<int>> ordering_seeds;
+    std::vector<std::array<int, 64>> action_prior;
+    std::vector<int> prior_total;
+
+    // macro mode: hold lengths in increasing order, empty to search single frames
+    std::vector<int> hold_lengths;
+    std::vector<int> split_last; // see run_split
+    std::vector<int> macro_inputs;
+    State macro_scratch;
+
+    // uses the seeds and the solutions of depths before this one, so resuming a depth sees the same prior
+    void build_prior(int depth) {
+        action_prior.clear();
+        prior_total.clear();
+        if (!learned_ordering) {
+            return;
+        }
+        auto add = [&](const std::vector<int> &sol) {
+            if (action_prior.size() < sol.size()) {
+                action_prior.resize(sol.size());
+                prior_total.resize(sol.size());
             }
-            std::cout << std::endl;
-            std::cout << "  frames: " << inputs.size() - 1 << std::endl;
-            return true;
+            for (std::size_t t = 0; t < sol.size(); t++) {
+                action_prior[t][sol[t] & 63]++;
+                prior_total[t]++;
+            }
+        };
+        for (auto &sol: ordering_seeds) {
+            add(sol);
+        }
+        for (auto &sol: solutions) {
+            if ((int) sol.size() < depth) {
+                add(sol);
+            }
+        }
+    }
+
+    // whether a node with depth left is a goal, and its actions if it's worth expanding
+    // returns the heuristic, used for ordering. nodes that are cut off update min_excess
+    double evaluate(const State &state, int depth, bool &goal, action_mask &actions) {
+        nodes++;
+        goal = false;
+        actions = 0;
+        if (depth == 0) {
+            goal = is_goal(state);
+            // with more depth, a leaf is expanded once its heuristic allows it. it's only worth computing while no
+            // node has needed less than 2 more
+            if (!depth_jumping) {
+                min_excess = 1;
+            }
+            else if (min_excess > 1) {
+                double h = goal ? 1 : h_cost(state);
+                if (h < min_excess) {
+                    min_excess = std::max(1, (int) std::ceil(h));
+                }
+            }
+            return goal ? 0 : HUGE_VAL;
+        }
+        if (depth < 0) {
+            // past the depth by a freeze or a macro, it's checked for the goal once the depth is -depth higher
+            min_excess = std::min(min_excess, -depth);
+            return HUGE_VAL;
+        }
+        double h = h_cost(state);
+        if (h <= depth) {
+            actions = search_actions(state);
+        }
+        else if (h - depth < min_excess) {
+            min_excess = (int) std::ceil(h - depth);
         }
+        return h;
+    }
 
+    // the next depth that can search nodes the iteration at depth didn't, past max_depth if there's none
+    int next_depth(int depth) const {
+        return min_excess > search_max_depth - depth ? search_max_depth + 1 : depth + min_excess;
+    }
+
+    // the frame above the top of the stack, whose state is about to be filled in
+    Frame &next_frame() {
+        if (height == stack.size()) {
+            stack.emplace_back();
+        }
+        return stack[height];
+    }
+
+    // transitions the state of f with every action, keeps the children that can lead to a goal and orders them
+    void expand(Frame &f, action_mask actions, std::size_t frame) {
+        f.count = 0;
+        f.next = 0;
+        if (!hold_lengths.empty() && !f.fine) {
+            expand_macros(f, actions, frame);
+            actions = 0;
+        }
+        for (; actions; actions &= actions - 1) {
+            if (f.count == f.children.size()) {
+                f.children.emplace_back();
+            }
+            Child &c = f.children[f.count];
+            c.action = std::countr_zero(actions);
+            c.freeze = transition_into(f.state, c.action, c.state);
+            double h = evaluate(c.state, f.depth - 1 - c.freeze, c.goal, c.actions);
+            if (c.goal || c.actions != 0) {
+                c.h = h;
+                c.score = move_score(f.state, c.state, c.action, h, frame);
+                c.inputs.clear();
+                c.features = hold_lengths.empty() ? 0 : macro_features(c.state);
+                c.fine = false;
+                c.run_action = -1;
+                f.count++;
+            }
+        }
+        // stable insertion sort, there are few children
+        f.order.resize(f.count);
+        for (std::size_t i = 0; i < f.count; i++) {
+            std::size_t j = i;
+            while (j > 0 && f.children[f.order[j - 1]].score > f.children[i].score) {
+                f.order[j] = f.order[j - 1];
+                j--;
+            }
+            f.order[j] = i;
+        }
+    }
+
+    // the last hold of a run of n transitions of one action, 0 if the hold lengths don't add up to n
+    // it's the longest one whose rest of the run adds up, so every run is split into holds in one way
+    int run_split(int n) {
+        while ((int) split_last.size() <= n) {
+            int m = (int) split_last.size();
+            int last = 0;
+            for (int l: hold_lengths) {
+                if (l == m || (l < m && split_last[m - l] != 0)) {
+                    last = l;
+                }
+            }
+            split_last.push_back(last);
+        }
+        return split_last[n];
+    }
+
+    // children of f in macro mode: every action held for each of the hold lengths, or until an event, whichever
+    // comes first. holds of one action share their frames, and a hold cut short by an event is only added once
+    // holding the action the parent macro held continues its run, and only the holds that split the run the way
+    // run_split does are added, so a sequence of inputs is reached in a single way (e.g. with {2, 4}, a run of 6
+    // is 2 + 4, never 4 + 2 or 2 + 2 + 2). a hold cut short by an event is only added by the last hold of the run
+    // that starts before it
+    void expand_macros(Frame &f, action_mask actions, std::size_t frame) {
+        int longest = hold_lengths.back();
+        for (; actions; actions &= actions - 1) {
+            int a = std::countr_zero(actions);
+            int run = a == f.run_action ? f.run_length : 0;
+            int next_run = run + 1; // the next run length a hold ends at
+            while (run_split(next_run) == 0) {
+                next_run++;
+            }
+            if (f.children.size() < f.count + longest) {
+                // no reallocation while prev points into the children
+                f.children.resize(f.count + longest);
+            }
+            const State *prev = &f.state;
+            unsigned features = f.features;
+            macro_inputs.clear();
+            for (int held = 1; held <= longest; held++) {
+                Child &c = f.children[f.count];
+                c.action = a;
+                c.freeze = transition_into(*prev, a, c.state);
+                macro_inputs.push_back(a);
+                macro_inputs.insert(macro_inputs.end(), c.freeze, 0);
+                double h = evaluate(c.state, f.depth - (int) macro_inputs.size(), c.goal, c.actions);
+                if (!c.goal && c.actions == 0) {
+                    break; // out of depth, or can't reach the goal anymore
+                }
+                unsigned now = macro_features(c.state);
+                bool event = c.goal || now != features || !((c.actions >> a) & 1);
+                if (event ? run + held <= next_run : run_split(run + held) == held) {
+                    c.h = h;
+                    c.score = move_score(f.state, c.state, a, h, frame);
+                    c.inputs = macro_inputs;
+                    c.features = now;
+                    c.fine = event;
+                    c.run_action = event ? -1 : a;
+                    c.run_length = run + held;
+                    f.count++;
+                    prev = &c.state;
+                }
+                else {
+                    std::swap(c.state, macro_scratch);
+                    prev = &macro_scratch;
+                }
+                if (event) {
+                    break;
+                }
+                features = now;
+            }
+        }
+    }
+
+    void push_root(const State &state, int depth, std::vector<int> &inputs, bool &found) {
+        Frame &f = next_frame();
+        f.state.assign(state);
+        load_state(f.state); // so actions are computed against the root's objects
+        f.depth = depth;
+        f.pushed = 0;
+        f.features = hold_lengths.empty() ? 0 : macro_features(f.state);
+        f.fine = false;
+        f.run_action = -1;
+        bool goal;
+        action_mask actions;
+        double h = evaluate(f.state, depth, goal, actions);
+        height++;
+        if (h < stats.best_h) {
+            stats.best_h = h;
+            stats.best_inputs = inputs;
+        }
+        if (goal) {
+            report_solution(inputs);
+            goals++;
+            found = true;
+        }
+        expand(f, actions, inputs.size());
+    }
+
+    // pushes the next child of the top frame
+    void push_child(std::vector<int> &inputs, bool &found) {
+        Frame &f = next_frame(); // may reallocate the stack, so the parent is looked up after
+        Frame &parent = stack[height - 1];
+        Child &c = parent.children[parent.order[parent.next++]];
+        std::swap(f.state, c.state);
+        if (c.inputs.empty()) {
+            f.pushed = c.freeze + 1;
+            inputs.push_back(c.action);
+            inputs.insert(inputs.end(), c.freeze, 0);
+        }
         else {
-            bool optimal_depth = false;
-            if (depth > 0 && h_cost(state) <= depth) {
-                for (auto a:get_actions(state)) {
-
-                    auto [new_state, freeze] = transition(state, a);
-                    // change: uses current array instead of allocating a new one
-                    // should be better performance wise, will probably check
-                    inputs.push_back(a);
-                    for (int i = 0; i < freeze; i++) {
-                        inputs.push_back(0);
-                    }
-                    bool done = iddfs(new_state, depth - 1 - freeze, inputs);
-                    if (done) {
-                        optimal_depth = true;
-                    }
+            f.pushed = c.inputs.size();
+            inputs.insert(inputs.end(), c.inputs.begin(), c.inputs.end());
+        }
+        f.depth = parent.depth - f.pushed;
+        f.features = c.features;
+        f.fine = c.fine;
+        f.run_action = c.run_action;
+        f.run_length = c.run_length;
+        height++;
+        if (c.h < stats.best_h) {
+            stats.best_h = c.h;
+            stats.best_inputs = inputs;
+        }
+        if (c.goal) {
+            report_solution(inputs);
+            goals++;
+            found = true;
+        }
+        expand(f, c.actions, inputs.size());
+    }
 
+    // starts the budgets of a search
+    void start_budget() {
+        budget.reset();
+        budget.deadline = time_limit > 0 ?
+                          std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_limit)) :
+                          std::chrono::steady_clock::time_point::max();
+        budget_check = budget.node_limit > 0 || time_limit > 0 ? nodes : std::numeric_limits<long long>::max();
+    }
+
+    // whether the search is out of budget. the deadline is only looked at every 1024 nodes
+    bool out_of_budget() {
+        if (!budget.stopped()) {
+            if (budget.node_limit > 0 && nodes >= budget.node_limit) {
+                budget.stop(CancellationToken::NODE_LIMIT);
+            }
+            else if (budget.past_deadline()) {
+                budget.stop(CancellationToken::DEADLINE);
+            }
+        }
+        if (budget.stopped()) {
+            return true; // budget_check stays passed, so every later step stops too
+        }
+        budget_check = nodes + 1024;
+        if (budget.node_limit > 0) {
+            budget_check = std::min(budget_check, budget.node_limit);
+        }
+        return false;
+    }
 
-                    // for (int i = 0; i < freeze; i++) {
-                    //     inputs.pop_back();
-                    // }
-                    // inputs.pop_back();
-                    inputs.resize(inputs.size()-freeze-1);
+    // runs a single step of the search: either searches the next child of the top node, or pops it
+    // returns false once the stack is empty, or the search is out of budget (the stack is then left as it is)
+    bool advance(std::vector<int> &inputs, bool &found) {
+        if (height == 0 || (nodes >= budget_check && out_of_budget())) {
+            return false;
+        }
+        Frame &top = stack[height - 1];
+        if (top.next < top.count) {
+            if (checkpointing && (nodes & 1023) == 0) {
+                auto now = std::chrono::steady_clock::now();
+                if (std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval) {
+                    iteration_found = found;
+                    write_checkpoint();
+                    last_checkpoint = now;
                 }
             }
-            return optimal_depth;
+            push_child(inputs, found);
         }
+        else {
+            inputs.resize(inputs.size() - top.pushed);
+            height--;
+        }
+        return true;
     }
 
-    std::vector<std::vector<int>> search(int max_depth, bool complete = false) {
-        solutions = std::vector<std::vector<int>>();
+    // rebuilds the stack from the number of searched children at each level
+    void restore_stack(const State &state, int depth, const std::vector<std::size_t> &path,
+                       std::vector<int> &inputs, bool &found) {
+        height = 0;
+        push_root(state, depth, inputs, found);
+        for (std::size_t k = 0; k < path.size(); k++) {
+            Frame &f = stack[height - 1];
+            bool last = k + 1 == path.size();
+            if (path[k] > f.count || (!last && path[k] == 0)) {
+                throw std::runtime_error("checkpoint doesn't match the search problem");
+            }
+            if (last) {
+                f.next = path[k];
+                break;
+            }
+            f.next = path[k] - 1;
+            push_child(inputs, found);
+        }
+    }
+
+    // format: one "key values..." entry per line
+    // the stack is stored as the number of searched children at each level, and rebuilt on resume
+    void write_checkpoint() {
+        std::string tmp = checkpoint_path + ".tmp";
+        {
+            std::ofstream out(tmp);
+            out << "cppleste-checkpoint 4\n";
+            out << "depth " << iteration_depth << "\n";
+            out << "max_depth " << search_max_depth << "\n";
+            out << "complete " << search_complete << "\n";
+            out << "found " << iteration_found << "\n";
+            out << "excess " << min_excess << "\n";
+            out << "stack " << height;
+            for (std::size_t k = 0; k < height; k++) {
+                out << " " << stack[k].next;
+            }
+            out << "\n";
+            out << "solutions " << solutions.size() << "\n";
+            for (auto &sol: solutions) {
+                out << sol.size();
+                for (auto i: sol) {
+                    out << " " << i;
+                }
+                out << "\n";
+            }
+            out << "counts " << sink.counts.size();
+            for (auto c: sink.counts) {
+                out << " " << c;
+            }
+            out << "\n";
+            out << "stream_size " << sink.stream_size() << "\n";
+        }
+        std::rename(tmp.c_str(), checkpoint_path.c_str());
+    }
+
+    std::vector<std::vector<int>>
+    run_search(const State &state, int start_depth, const std::vector<std::size_t> &resume_path, bool resume_found) {
         auto t1 = std::chrono::high_resolution_clock::now();
-        init_state();
-        State state(p8);
+        last_checkpoint = std::chrono::steady_clock::now();
+        checkpointing = !checkpoint_path.empty();
+        stats = SearchStats();
+        start_budget();
 
-        std::cout << "searching..." << std::endl;
-        for (int depth = 0; depth <= max_depth; depth++) {
-            std::cout << "depth " << depth << "..." << std::endl;
+        if (!quiet) {
+            std::cout << "searching..." << std::endl;
+        }
+        for (int depth = start_depth; depth <= search_max_depth; depth = next_depth(depth)) {
+            if (!quiet) {
+                std::cout << "depth " << depth << "..." << std::endl;
+            }
+            iteration_depth = depth;
+            stats.depth = depth;
+            build_prior(depth);
             std::vector<int> inputs;
-            bool done = iddfs(state, depth, inputs) && !complete;
-            auto t2 = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> elapsed_time = t2 - t1;
-            std::cout << "  elapsed time: " << std::fixed << std::setprecision(2) << (elapsed_time.count()) << " [s]"
-                      << std::endl;
+            bool found = false;
+            if (depth == start_depth && !resume_path.empty()) {
+                found = resume_found; // min_excess is the checkpoint's
+                restore_stack(state, depth, resume_path, inputs, found);
+            }
+            else {
+                min_excess = std::numeric_limits<int>::max();
+                height = 0;
+                push_root(state, depth, inputs, found);
+            }
+            while (!(first_only && found) && advance(inputs, found)) {}
+
+            bool done = found && (!search_complete || first_only);
+            if (!quiet) {
+                if (sink.mode != SolutionSink::STORE && depth < (int) sink.counts.size() && sink.counts[depth] > 0) {
+                    std::cout << "  solutions: " << sink.counts[depth] << std::endl;
+                }
+                auto t2 = std::chrono::high_resolution_clock::now();
+                std::chrono::duration<double> elapsed_time = t2 - t1;
+                std::cout << "  elapsed time: " << std::fixed << std::setprecision(2) << (elapsed_time.count())
+                          << " [s]" << std::endl;
+            }
+            if (budget.stopped()) {
+                if (!quiet) {
+                    std::cout << (budget.reason() == CancellationToken::DEADLINE ? "  time limit reached" :
+                                  "  node limit reached") << std::endl;
+                }
+                if (checkpointing) {
+                    iteration_found = found;
+                    write_checkpoint();
+                }
+                break;
+            }
+            // the depths skipped up to the next one can't have solutions either
+            stats.completed_depth = done ? depth : next_depth(depth) - 1;
+            if (!quiet && !done && next_depth(depth) > depth + 1) {
+                std::cout << "  nothing new before depth " << next_depth(depth) << std::endl;
+            }
+            if (checkpointing) {
+                // the next iteration starts from scratch, a finished search resumes past max_depth
+                iteration_depth = done ? search_max_depth + 1 : next_depth(depth);
+                iteration_found = false;
+                write_checkpoint();
+            }
             if (done) {
                 break;
             }
         }
+        checkpointing = false;
+        if (sink.mode == SolutionSink::STREAM) {
+            sink.stream.close();
+        }
+        finish_stats(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t1).count());
         return solutions;
     }
 
-    typename Cart::player *find_player(const objlist &objs) {
+    void finish_stats(double seconds) {
+        stats.nodes = nodes;
+        stats.solution_count = sink.total;
+        stats.stop_reason = budget.reason();
+        stats.seconds = seconds;
+        budget_check = std::numeric_limits<long long>::max(); // so iddfs outside of a search isn't limited
+    }
+
+public:
+    bool iddfs(const State &state, int depth, std::vector<int> &inputs) {
+        // keep the frames of a search this is called from intact
+        std::size_t outer = height;
+        bool found = false;
+        push_root(state, depth, inputs, found);
+        std::size_t base = height - 1;
+        while (height > base && advance(inputs, found)) {}
+        height = outer;
+        return found;
+    }
+
+    // periodically save the search progress to path, so it can be continued with resume(path)
+    void enable_checkpoints(const std::string &path, double interval_seconds = 60) {
+        checkpoint_path = path;
+        checkpoint_interval = interval_seconds;
+    }
+
+    // search children in an order learned from the solutions of earlier depths and the given seeds
+    // (e.g. solutions of a similar search), on top of the heuristic. see move_score
+    // when resuming from a checkpoint, the ordering settings have to be the same as the ones it was written with
+    void learn_ordering(const std::vector<std::vector<int>> &seeds = {}) {
+        learned_ordering = true;
+        ordering_seeds = seeds;
+    }
+
+    // end the search at the first solution found, instead of finishing its depth
+    void stop_at_first_solution(bool stop = true) {
+        first_only = stop;
+    }
+
+    // search macro actions instead of single frames: every allowed input held for each of the given numbers of
+    // frames. a hold ends early at an event: macro_features changing, the input no longer being allowed, or the
+    // goal, and the state it ends in branches frame by frame. solutions are still per frame inputs
+    // this only searches a subset of the inputs, so it can miss solutions. an empty list searches single frames
+    void set_hold_lengths(std::vector<int> lengths) {
+        std::sort(lengths.begin(), lengths.end());
+        lengths.erase(std::unique(lengths.begin(), lengths.end()), lengths.end());
+        lengths.erase(std::remove_if(lengths.begin(), lengths.end(), [](int l) { return l < 1; }), lengths.end());
+        hold_lengths = lengths;
+        split_last.clear();
+    }
+
+    std::vector<std::vector<int>> search(int max_depth, bool complete = false) {
+        solutions = std::vector<std::vector<int>>();
+        nodes = 0;
+        search_max_depth = max_depth;
+        search_complete = complete;
+        sink.reset();
+        sink.open();
+        State state = initial_state();
+        return run_search(state, 0, {}, false);
+    }
+
+    // the same search as search(), but as a sequence of events: each solution as soon as it's found, and the end of
+    // each depth searched (like search(), it skips depths that can't have solutions). the search only runs while
+    // the caller reads events, so it can be paused between any two of them, and stops when the generator is
+    // destroyed. solutions aren't kept in the solutions list (STORE only counts them while streaming, the other
+    // modes work as usual), and neither solutions nor progress are printed. checkpoints aren't written
+    // the budgets apply, and the time limit includes the time the stream spends paused. a stream that runs out of
+    // budget ends without a DEPTH_DONE for the depth it stopped in
+    // the searcheline has to outlive the generator, and can't be used for anything else while it's running
+    //   for (auto &e: s.search_stream(50)) if (e.kind == SearchEvent::SOLUTION) ...
+    Generator<SearchEvent> search_stream(int max_depth, bool complete = false) {
+        // puts the sink back however the stream ends
+        struct RestoreSink {
+            SolutionSink &sink;
+            SolutionSink::Mode mode;
+            std::size_t sample_size;
+            bool verbose;
+            ~RestoreSink() {
+                sink.mode = mode;
+                sink.sample_size = sample_size;
+                sink.verbose = verbose;
+            }
+        } restore{sink, sink.mode, sink.sample_size, sink.verbose};
+        sink.verbose = false;
+        if (sink.mode == SolutionSink::STORE) {
+            sink.mode = SolutionSink::COUNT;
+            sink.sample_size = 0;
+        }
+        solutions = std::vector<std::vector<int>>();
+        nodes = 0;
+        search_max_depth = max_depth;
+        search_complete = complete;
+        sink.reset();
+        sink.open();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        stats = SearchStats();
+        start_budget();
+        State state = initial_state();
+
+        for (int depth = 0; depth <= max_depth; depth = next_depth(depth)) {
+            iteration_depth = depth;
+            stats.depth = depth;
+            build_prior(depth);
+            std::vector<int> inputs;
+            bool found = false;
+            min_excess = std::numeric_limits<int>::max();
+            height = 0;
+            long long reported = goals;
+            push_root(state, depth, inputs, found);
+            // a step finds at most one solution, the node it just pushed, so inputs are still the solution's
+            do {
+                if (goals != reported) {
+                    reported = goals;
+                    SearchEvent event;
+                    event.depth = depth;
+                    event.inputs = inputs;
+                    event.nodes = nodes;
+                    co_yield std::move(event);
+                }
+            } while (!(first_only && found) && advance(inputs, found));
+            if (budget.stopped()) {
+                break;
+            }
+            stats.completed_depth = found && (!complete || first_only) ? depth : next_depth(depth) - 1;
+
+            SearchEvent event;
+            event.kind = SearchEvent::DEPTH_DONE;
+            event.depth = depth;
+            event.solutions = depth < (int) sink.counts.size() ? sink.counts[depth] : 0;
+            event.nodes = nodes;
+            co_yield std::move(event);
+            if (found && (!complete || first_only)) {
+                break;
+            }
+        }
+        if (sink.mode == SolutionSink::STREAM) {
+            sink.stream.close();
+        }
+        finish_stats(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t1).count());
+    }
+
+    // continue a search from a checkpoint written by a search with enable_checkpoints
+    // keeps writing checkpoints to the same file
+    std::vector<std::vector<int>> resume(const std::string &path) {
+        std::ifstream in(path);
+        std::string key;
+        int version;
+        if (!(in >> key >> version) || key != "cppleste-checkpoint" || version != 4) {
+            throw std::runtime_error("not a checkpoint file: " + path);
+        }
+        int depth = 0;
+        bool found = false;
+        std::vector<std::size_t> resume_path;
+        std::uintmax_t stream_size = 0;
+        solutions = std::vector<std::vector<int>>();
+        sink.reset();
+        while (in >> key) {
+            if (key == "depth") {
+                in >> depth;
+            }
+            else if (key == "max_depth") {
+                in >> search_max_depth;
+            }
+            else if (key == "complete") {
+                in >> search_complete;
+            }
+            else if (key == "found") {
+                in >> found;
+            }
+            else if (key == "excess") {
+                in >> min_excess;
+            }
+            else if (key == "stack") {
+                std::size_t n;
+                in >> n;
+                resume_path.resize(n);
+                for (auto &i: resume_path) {
+                    in >> i;
+                }
+            }
+            else if (key == "solutions") {
+                std::size_t n;
+                in >> n;
+                solutions.resize(n);
+                for (auto &sol: solutions) {
+                    std::size_t len;
+                    in >> len;
+                    sol.resize(len);
+                    for (auto &i: sol) {
+                        in >> i;
+                    }
+                }
+            }
+            else if (key == "counts") {
+                std::size_t n;
+                in >> n;
+                sink.counts.resize(n);
+                for (auto &c: sink.counts) {
+                    in >> c;
+                    sink.total += c;
+                }
+            }
+            else if (key == "stream_size") {
+                in >> stream_size;
+            }
+        }
+        if (!in.eof()) {
+            throw std::runtime_error("corrupt checkpoint file: " + path);
+        }
+        if (checkpoint_path.empty()) {
+            checkpoint_path = path;
+            checkpoint_interval = 60;
+        }
+        sink.open(stream_size);
+        nodes = 0;
+        State state = initial_state();
+        return run_search(state, depth, resume_path, found);
+    }
+
+    template<typename List>
+    typename Cart::player *find_player(const List &objs) {
         for (auto &o: objs) {
             if (o && o->type_id==Cart::player::type_enum) {
                 return dynamic_cast<typename Cart::player *>(o.get());
@@ -223,7 +1358,8 @@ public:
         return nullptr;
     }
 
-    typename Cart::player_spawn *find_player_spawn(const objlist &objs) {
+    template<typename List>
+    typename Cart::player_spawn *find_player_spawn(const List &objs) {
         for (auto &o: objs) {
             if (o && o->type_id==Cart::player_spawn::type_enum) {
                 return dynamic_cast<typename Cart::player_spawn *>(o.get());
@@ -0,0 +1,230 @@
+#ifndef CPPLESTE_TASREPLAY_H
+#define CPPLESTE_TASREPLAY_H
+
+#include <vector>
+#include "PICO8.h"
+#include "Carts/Celeste.h"
+#include "CelesteUtils.h"
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <istream>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+// an input file to replay
+// on disk, one tape per line: "room; inputs; expected trace"
+// inputs are comma or space separated button states (the same format searcheline prints solutions in),
+// the expected trace is an optional list of per frame utils::state_hash values in hex
+// empty lines and lines starting with # are skipped
+struct Tape {
+    int room = 0; // -1 to replay from whatever state the setup function leaves
+    std::vector<int> inputs;
+    std::vector<std::uint64_t> expected;
+
+    static Tape parse(const std::string &line) {
+        Tape t;
+        std::string fields[3];
+        std::size_t start = 0;
+        for (int i = 0; i < 3; i++) {
+            std::size_t end = line.find(';', start);
+            fields[i] = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            if (end == std::string::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+        auto tokens = [](std::string s) {
+            std::replace(s.begin(), s.end(), ',', ' ');
+            std::istringstream ss(s);
+            std::vector<std::string> out;
+            std::string tok;
+            while (ss >> tok) {
+                out.push_back(tok);
+            }
+            return out;
+        };
+        auto room = tokens(fields[0]);
+        if (room.size() != 1) {
+            throw std::runtime_error("bad tape: " + line);
+        }
+        t.room = std::stoi(room[0]);
+        for (auto &tok: tokens(fields[1])) {
+            t.inputs.push_back(std::stoi(tok));
+        }
+        for (auto &tok: tokens(fields[2])) {
+            t.expected.push_back(std::strtoull(tok.c_str(), nullptr, 16));
+        }
+        return t;
+    }
+};
+
+struct ReplayResult {
+    std::size_t tape = 0; // line index of the tape among the tapes read
+    std::uint64_t final_hash = 0;
+    int frames = 0; // number of frames played
+    int death_frame = -1; // frame the player died on
+    int exit_frame = -1; // frame the player left the level on
+    int divergence = -1; // first frame that doesn't match the expected trace
+    std::vector<std::uint64_t> trace; // per frame hashes, if record_traces is set
+};
+
+// replays many tapes on several threads, each with its own PICO-8 instance
+// nothing is printed and nothing sleeps, frames are stepped as fast as possible
+template<typename Cart=Celeste>
+class TasReplay {
+public:
+    using Setup = std::function<void(PICO8<Cart> &, const Tape &)>;
+
+    int thread_count;
+    bool stop_at_event = true; // stop a tape at the frame the player dies or exits
+    bool record_traces = false;
+    Setup setup;
+
+    long long frames_played = 0;
+    double seconds = 0;
+
+    // the instances are reused between tapes, so everything a tape can leave behind (a pending freeze, restart or
+    // transition, the player paused by the big chest, the orb's extra dash) is reset to what a new cart starts with
+    static void default_setup(PICO8<Cart> &p8, const Tape &tape) {
+        if (tape.room >= 0) {
+            utils::start_room(p8, tape.room);
+        }
+    }
+
+    explicit TasReplay(int thread_count, Setup setup = default_setup) :
+            thread_count(thread_count),
+            setup(setup) {}
+
+    ReplayResult replay(PICO8<Cart> &p8, const Tape &tape) const {
+        ReplayResult r;
+        setup(p8, tape);
+        for (std::size_t i = 0; i < tape.inputs.size(); i++) {
+            auto *p = p8.game().get_player();
+            bool had_player = p != nullptr && p->type_id == Cart::player::type_enum;
+            p8.set_btn_state(tape.inputs[i]);
+            p8.step_headless();
+            r.frames++;
+
+            if (!tape.expected.empty() || record_traces) {
+                std::uint64_t h = utils::state_hash(p8);
+                if (r.divergence == -1 && i < tape.expected.size() && tape.expected[i] != h) {
+                    r.divergence = i;
+                }
+                if (record_traces) {
+                    r.trace.push_back(h);
+                }
+            }
+
+            if (had_player) {
+                p = p8.game().get_player();
+                if (p == nullptr && p8.game().delay_restart > 0) {
+                    r.death_frame = i;
+                }
+                else if (p != nullptr && p->type_id == Cart::player_spawn::type_enum) {
+                    r.exit_frame = i;
+                }
+                if (stop_at_event && (r.death_frame != -1 || r.exit_frame != -1)) {
+                    break;
+                }
+            }
+        }
+        if (r.divergence == -1 && r.frames < (int) tape.expected.size()) {
+            r.divergence = r.frames; // the expected trace is longer than what was played
+        }
+        r.final_hash = utils::state_hash(p8);
+        return r;
+    }
+
+    // replays every tape in the stream, tapes are read as the threads need them
+    std::vector<ReplayResult> run(std::istream &tapes) {
+        std::mutex read_lock;
+        std::mutex result_lock;
+        std::size_t next_index = 0;
+        std::vector<ReplayResult> results;
+        frames_played = 0;
+        std::string error;
+
+        auto t1 = std::chrono::high_resolution_clock::now();
+        auto work = [&]() {
+            auto p8 = std::make_unique<PICO8<Cart>>();
+            utils::enable_loop_mode(*p8);
+            std::vector<ReplayResult> local;
+            long long frames = 0;
+            std::string line;
+            while (true) {
+                std::size_t index;
+                {
+                    std::lock_guard<std::mutex> lock(read_lock);
+                    bool got = false;
+                    while (std::getline(tapes, line)) {
+                        auto first = line.find_first_not_of(" \t\r");
+                        if (first != std::string::npos && line[first] != '#') {
+                            got = true;
+                            break;
+                        }
+                    }
+                    if (!got || !error.empty()) {
+                        break;
+                    }
+                    index = next_index++;
+                }
+                try {
+                    ReplayResult r = replay(*p8, Tape::parse(line));
+                    r.tape = index;
+                    frames += r.frames;
+                    local.push_back(std::move(r));
+                }
+                catch (const std::exception &e) {
+                    std::lock_guard<std::mutex> lock(read_lock);
+                    error = e.what();
+                    break;
+                }
+            }
+            std::lock_guard<std::mutex> lock(result_lock);
+            frames_played += frames;
+            for (auto &r: local) {
+                results.push_back(std::move(r));
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++) {
+            threads.emplace_back(work);
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        seconds = std::chrono::duration<double>(t2 - t1).count();
+
+        std::sort(results.begin(), results.end(), [](const ReplayResult &a, const ReplayResult &b) {
+            return a.tape < b.tape;
+        });
+        return results;
+    }
+
+    std::vector<ReplayResult> run_file(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("can't open " + path);
+        }
+        return run(in);
+    }
+
+    double frames_per_second() const {
+        return seconds > 0 ? frames_played / seconds : 0;
+    }
+};
+
+#endif //CPPLESTE_TASREPLAY_H
@@ -0,0 +1,429 @@
+// checks of search and replay behaviour that the benchmarks don't cover
+//
+//   CpplesteTests [test...]   run the tests (all of them if none are given), exits with 1 if any failed
+//   CpplesteTests --list      print the test names
+
+#include "Searcheline.h"
+#include "ProcessSearcheline.h"
+#include "TasReplay.h"
+#include "CelesteUtils.h"
+#include "Carts/Celeste.h"
+#include "CpplesteEnv.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <csignal>
+#include <unistd.h>
+
+using namespace std;
+
+// the problem of ExampleSearcheline2100
+class Search2100 : public Searcheline<> {
+    void init_state() override {
+        utils::load_room(p8, 20);
+        utils::supress_object<Celeste::balloon>(p8);
+        utils::skip_player_spawn(p8);
+    }
+    vector<int> allowable_actions(const State &state, Celeste::player &player, bool h_movement, bool can_jump,
+                                  bool can_dash) override {
+        vector<int> actions{0b000010};
+        if (can_jump) {
+            actions.push_back(0b010010);
+        }
+        if (can_dash) {
+            actions.push_back(0b100110);
+        }
+        return actions;
+    }
+    int exit_heuristic(const Celeste::player &player) override {
+        return ceil((player.y + 4) / 4);
+    }
+};
+
+// holds that add up to the same frames are only searched once, so a macro search never finds a solution twice,
+// and only finds solutions the frame by frame search finds too
+bool macro_solutions_unique() {
+    Search2100 frames;
+    frames.set_quiet();
+    frames.set_verbose(false);
+    auto all = frames.search(40, true);
+    set<vector<int>> reachable(all.begin(), all.end());
+
+    bool ok = true;
+    for (auto lengths: vector<vector<int>>{{2, 4, 8}, {3, 6}, {2, 3, 5}, {1, 2}}) {
+        Search2100 s;
+        s.set_quiet();
+        s.set_verbose(false);
+        s.set_hold_lengths(lengths);
+        auto sols = s.search(40, true);
+        set<vector<int>> unique(sols.begin(), sols.end());
+        bool subset = includes(reachable.begin(), reachable.end(), unique.begin(), unique.end());
+        cout << "  holds";
+        for (auto l: lengths) {
+            cout << " " << l;
+        }
+        cout << ": " << sols.size() << " solutions, " << unique.size() << " distinct" << endl;
+        if (unique.size() != sols.size() || !subset) {
+            ok = false;
+        }
+    }
+    // holding for 1 frame covers every input sequence
+    Search2100 fine;
+    fine.set_quiet();
+    fine.set_verbose(false);
+    fine.set_hold_lengths({1, 2});
+    auto sols = fine.search(40, true);
+    if (set<vector<int>>(sols.begin(), sols.end()) != reachable) {
+        cout << "  holds 1 2 don't find the frame by frame solutions" << endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// streaming a search doesn't print anything, even with a verbose searcheline
+bool stream_prints_nothing() {
+    Search2100 s;
+    ostringstream out;
+    auto *old = cout.rdbuf(out.rdbuf());
+    int found = 0;
+    for (auto &e: s.search_stream(40, true)) {
+        found += e.kind == SearchEvent::SOLUTION;
+    }
+    cout.rdbuf(old);
+    cout << "  " << found << " solutions, " << out.str().size() << " characters printed" << endl;
+    return found == 17 && out.str().empty();
+}
+
+// searching in worker processes finds what a single process does
+bool process_search_matches() {
+    Search2100 single;
+    single.set_quiet();
+    single.set_verbose(false);
+    auto expected = single.search(40, true);
+
+    ProcessSearcheline<Search2100> processes(2);
+    processes.set_quiet();
+    processes.set_verbose(false);
+    auto sols = processes.search(40, true);
+    cout << "  " << sols.size() << " solutions, " << expected.size() << " in a single process, searched up to depth "
+         << processes.completed_depth << endl;
+    return set<vector<int>>(sols.begin(), sols.end()) == set<vector<int>>(expected.begin(), expected.end()) &&
+           sols.size() == expected.size() && processes.completed_depth == 40;
+}
+
+// 2100m, but a worker is killed once it has evaluated enough nodes in a depth
+class CrashingSearch : public Search2100 {
+public:
+    static inline pid_t coordinator = 0;
+    int evaluated = 0;
+    double h_cost(const State &state) override {
+        if (getpid() != coordinator && ++evaluated > 300) {
+            raise(SIGKILL);
+        }
+        return Searcheline::h_cost(state);
+    }
+};
+
+// a crashed worker's subtree isn't searched, so the search stops instead of going on to deeper depths
+bool process_search_worker_crash() {
+    Search2100 single;
+    single.set_quiet();
+    single.set_verbose(false);
+    auto all = single.search(40, true);
+    set<vector<int>> reachable(all.begin(), all.end());
+
+    CrashingSearch::coordinator = getpid();
+    ProcessSearcheline<CrashingSearch> processes(2);
+    processes.set_quiet();
+    processes.set_verbose(false);
+    auto sols = processes.search(40, true);
+    set<vector<int>> found(sols.begin(), sols.end());
+    cout << "  " << sols.size() << " solutions, searched up to depth " << processes.completed_depth << endl;
+    return processes.completed_depth >= 0 && processes.completed_depth < 40 &&
+           includes(reachable.begin(), reachable.end(), found.begin(), found.end());
+}
+
+// 2100m without the dash, restricted through get_actions (on top of the default one)
+class NoDashActions : public Search2100 {
+    vector<int> get_actions(const State &state) override {
+        auto actions = Searcheline::get_actions(state);
+        erase(actions, 0b100110);
+        return actions;
+    }
+};
+
+// and through allowable_actions
+class NoDashAllowable : public Searcheline<> {
+    void init_state() override {
+        utils::load_room(p8, 20);
+        utils::supress_object<Celeste::balloon>(p8);
+        utils::skip_player_spawn(p8);
+    }
+    vector<int> allowable_actions(const State &state, Celeste::player &player, bool h_movement, bool can_jump,
+                                  bool can_dash) override {
+        vector<int> actions{0b000010};
+        if (can_jump) {
+            actions.push_back(0b010010);
+        }
+        return actions;
+    }
+    int exit_heuristic(const Celeste::player &player) override {
+        return ceil((player.y + 4) / 4);
+    }
+};
+
+// the search calls get_actions and allowable_actions when they're overridden, and the default mask allows what the
+// default allowable_actions always listed
+bool action_hooks_used() {
+    bool ok = true;
+    for (int checks = 0; checks < 8; checks++) {
+        bool h_movement = checks & 1, can_jump = checks & 2, can_dash = checks & 4;
+        vector<int> listed{0b000000};
+        if (h_movement) {
+            listed.insert(listed.end(), {0b000001, 0b000010});
+        }
+        if (can_jump) {
+            listed.push_back(0b010000);
+            if (h_movement) {
+                listed.insert(listed.end(), {0b010001, 0b010010});
+            }
+        }
+        if (can_dash) {
+            listed.insert(listed.end(), {0b100000, 0b100001, 0b100010, 0b100100, 0b100101, 0b100110, 0b101000,
+                                         0b101001, 0b101010});
+        }
+        if (Searcheline<>::default_action_mask(h_movement, can_jump, can_dash) != Searcheline<>::to_mask(listed)) {
+            cout << "  the default mask differs for checks " << checks << endl;
+            ok = false;
+        }
+    }
+
+    Search2100 all;
+    NoDashActions by_actions;
+    NoDashAllowable by_allowable;
+    long long nodes[3];
+    set<vector<int>> found[3];
+    int i = 0;
+    for (Searcheline<> *s: {(Searcheline<> *) &all, (Searcheline<> *) &by_actions, (Searcheline<> *) &by_allowable}) {
+        s->set_quiet();
+        s->set_verbose(false);
+        auto sols = s->search(40, true);
+        found[i] = set<vector<int>>(sols.begin(), sols.end());
+        nodes[i] = s->node_count();
+        i++;
+    }
+    cout << "  nodes: " << nodes[0] << " with the dash, " << nodes[1] << " without it through get_actions, "
+         << nodes[2] << " through allowable_actions" << endl;
+    if (nodes[1] >= nodes[0] || nodes[1] != nodes[2] || found[1] != found[2]) {
+        cout << "  an overridden hook wasn't used" << endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// 2100m, counting the h_cost calls
+class CountingSearch : public Search2100 {
+public:
+    long long h_calls = 0;
+    double h_cost(const State &state) override {
+        h_calls++;
+        return Searcheline::h_cost(state);
+    }
+};
+
+// without depth jumping, leaves don't compute h_cost, and the search finds the same solutions
+bool depth_jumping_off() {
+    bool ok = true;
+    set<vector<int>> found[2];
+    for (int on = 0; on < 2; on++) {
+        CountingSearch leaf;
+        leaf.set_quiet();
+        leaf.set_verbose(false);
+        leaf.set_depth_jumping(on);
+        leaf.search(0); // the root is the only node, and a leaf
+        CountingSearch s;
+        s.set_quiet();
+        s.set_verbose(false);
+        s.set_depth_jumping(on);
+        auto sols = s.search(40, true);
+        found[on] = set<vector<int>>(sols.begin(), sols.end());
+        cout << "  jumping " << (on ? "on" : "off") << ": " << leaf.h_calls << " h_cost calls at depth 0, "
+             << s.node_count() << " nodes, " << sols.size() << " solutions" << endl;
+        if (leaf.h_calls != on) {
+            ok = false;
+        }
+    }
+    return ok && found[0] == found[1] && !found[0].empty();
+}
+
+// a tape replays the same after any other tape as on a new instance
+bool replays_the_same_after(const string &before) {
+    TasReplay<> replay(1);
+    replay.record_traces = true;
+    Tape tape = Tape::parse("0; 2, 2, 18, 2, 2, 2, 34, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2");
+
+    PICO8<Celeste> fresh;
+    utils::enable_loop_mode(fresh);
+    ReplayResult expected = replay.replay(fresh, tape);
+
+    PICO8<Celeste> reused;
+    utils::enable_loop_mode(reused);
+    ReplayResult first = replay.replay(reused, Tape::parse(before));
+    cout << "  first tape: " << first.frames << " frames, death on " << first.death_frame << ", restart in "
+         << reused.game().delay_restart << ", player paused " << reused.game().pause_player << endl;
+    ReplayResult r = replay.replay(reused, tape);
+    if (r.trace != expected.trace || r.final_hash != expected.final_hash || r.death_frame != expected.death_frame ||
+        r.exit_frame != expected.exit_frame) {
+        cout << "  the tape replayed differently" << endl;
+        return false;
+    }
+    return true;
+}
+
+// the state hash changes with every field an object's equals compares, not just its position and speed
+bool hash_covers_object_state() {
+    PICO8<Celeste> p8;
+    utils::enable_loop_mode(p8);
+    utils::start_room(p8, 20);
+    auto &g = p8.game();
+    auto *p = static_cast<Celeste::player *>(g.get_player());
+    Celeste::spring *s = nullptr;
+    for (auto &o: g.objects) {
+        if (o != nullptr && o->type_id == Celeste::SPRING) {
+            s = static_cast<Celeste::spring *>(o.get());
+        }
+    }
+    // each change is undone by calling it again with -1
+    vector<pair<string, function<void(int)>>> changes = {
+            {"djump",          [&](int d) { p->djump += d; }},
+            {"grace",          [&](int d) { p->grace += d; }},
+            {"jbuffer",        [&](int d) { p->jbuffer += d; }},
+            {"dash_time",      [&](int d) { p->dash_time += d; }},
+            {"p_dash",         [&](int) { p->p_dash = !p->p_dash; }},
+            {"dash_target",    [&](int d) { p->dash_target.x += d; }},
+            {"spring hide_in", [&](int d) { s->hide_in += d; }},
+    };
+    uint64_t before = utils::state_hash(p8);
+    bool ok = true;
+    for (auto &[name, change]: changes) {
+        change(1);
+        uint64_t changed = utils::state_hash(p8);
+        change(-1);
+        if (changed == before || utils::state_hash(p8) != before) {
+            cout << "  " << name << " doesn't change the hash" << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// stopped on the frame the player dies, so the restart is pending
+bool replay_after_death() {
+    return replays_the_same_after("2; 8, 30, 47, 8, 9, 40, 38, 40, 26, 20, 24, 54, 0, 31, 38, 18, 46, 41, 22, 48, "
+                                  "55, 25, 29, 46, 42");
+}
+
+// opens the big chest of 2200m, which pauses the player until its orb appears
+const string chest_tape = "21; 34, 2, 18, 2, 34, 2, 0, 1, 34, 2, 34, 0, 1, 2, 2, 2, 17, 2, 18, 0, 17, 38, 18, 17, 38, "
+                          "17, 18, 2, 2, 18, 1, 2, 38, 18, 38, 34, 2, 0, 0, 2, 2, 38, 18, 34, 2, 0";
+// then picks up the orb, which gives a second dash
+const string orb_inputs = "18, 0, 16, 20, 8, 16, 2, 17, 18, 18, 8, 8, 8, 18, 16, 2, 1, 20, 0, 2, 0, 8, 1, 4, 18, 0, 17, "
+                          "8, 1, 0, 20, 4, 1, 17, 8, 17, 0, 1, 2, 20, 20, 8, 20, 18, 8, 20, 17, 17, 8, 1, 8, 8, 0, 1, "
+                          "4, 20, 8, 4, 0, 17, 8, 4, 4, 0, 20, 16, 18, 8, 4, 17, 4, 18, 4, 17, 8, 4, 1, 4, 16, 1, 1, "
+                          "20, 18, 18, 8, 18, 4, 1, 0, 1, 2, 1, 1";
+
+// stopped while the chest opens
+bool replay_after_chest() {
+    return replays_the_same_after(chest_tape);
+}
+
+// an env pool episode that picks up the orb doesn't carry the extra dash (or anything else) into the next one
+bool env_reset_after_orb() {
+    cppleste_env_config config;
+    cppleste_env_config_init(&config);
+    config.thread_count = 1;
+    config.room = 21;
+
+    vector<float> expected(CPPLESTE_ENV_OBS_SIZE);
+    cppleste_env_pool *fresh = cppleste_env_pool_create(&config);
+    cppleste_env_pool_reset(fresh, expected.data());
+    cppleste_env_pool_destroy(fresh);
+
+    cppleste_env_pool *pool = cppleste_env_pool_create(&config);
+    vector<float> obs(CPPLESTE_ENV_OBS_SIZE);
+    cppleste_env_pool_reset(pool, obs.data());
+    uint8_t done = 0;
+    for (int a: Tape::parse(chest_tape + ", " + orb_inputs).inputs) {
+        uint8_t buttons = a;
+        cppleste_env_pool_step(pool, &buttons, obs.data(), nullptr, &done, nullptr);
+        if (done) {
+            break;
+        }
+    }
+    float max_djump = obs[CPPLESTE_ENV_OBS_PLAYER + 2];
+    cppleste_env_pool_reset(pool, obs.data());
+    cppleste_env_pool_destroy(pool);
+    cout << "  max_djump " << max_djump << " after the orb, " << obs[CPPLESTE_ENV_OBS_PLAYER + 2] << " after the reset"
+         << endl;
+    if (done || max_djump != 2) {
+        cout << "  the episode didn't get the orb" << endl;
+        return false;
+    }
+    if (obs != expected) {
+        cout << "  the reset observation differs from a new pool's" << endl;
+        return false;
+    }
+    return true;
+}
+
+// name, and the test. names can't have spaces
+const vector<pair<string, function<bool()>>> tests = {
+        {"macro_solutions_unique",      macro_solutions_unique},
+        {"action_hooks_used",           action_hooks_used},
+        {"hash_covers_object_state",    hash_covers_object_state},
+        {"depth_jumping_off",           depth_jumping_off},
+        {"process_search_matches",      process_search_matches},
+        {"process_search_worker_crash", process_search_worker_crash},
+        {"replay_after_death",          replay_after_death},
+        {"replay_after_chest",          replay_after_chest},
+        {"env_reset_after_orb",         env_reset_after_orb},
+        {"stream_prints_nothing",       stream_prints_nothing},
+};
+
+int main(int argc, char **argv) {
+    vector<string> names;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--list") {
+            for (auto &t: tests) {
+                cout << t.first << "\n";
+            }
+            return 0;
+        }
+        names.push_back(arg);
+    }
+    if (names.empty()) {
+        for (auto &t: tests) {
+            names.push_back(t.first);
+        }
+    }
+    bool failed = false;
+    for (auto &name: names) {
+        auto it = find_if(tests.begin(), tests.end(), [&](auto &t) { return t.first == name; });
+        if (it == tests.end()) {
+            cerr << "unknown test " << name << endl;
+            return 2;
+        }
+        cout << name << endl;
+        bool ok = it->second();
+        cout << (ok ? "  ok" : "  FAIL") << endl;
+        failed |= !ok;
+    }
+    return failed ? 1 : 0;
+}
@@ -17,6 +17,73 @@
 #include <queue>
 #include <atomic>
 #include <functional>
+#include <fstream>
+#include <string>
+
+// timeline of what the threads of a ThreadedSearcheline did, written in the chrome trace format
+// (open it in ui.perfetto.dev or chrome://tracing)
+// every thread only appends to its own buffer, so recording events takes no locks
+struct SearchTrace {
+    struct Event {
+        const char *name;
+        char phase; // 'X' for events with a duration, 'i' for instants
+        long long start; // ns since the search started
+        long long duration;
+        const char *arg_name; // nullptr if the event has no argument
+        long long arg;
+    };
+    std::chrono::steady_clock::time_point origin;
+    std::vector<std::vector<Event>> threads; // 0 is the thread that called search, worker i is i+1
+
+    void reset(int thread_count) {
+        origin = std::chrono::steady_clock::now();
+        threads.assign(thread_count, {});
+    }
+
+    long long now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    // an event from start until now
+    void complete(int thread, const char *name, long long start, const char *arg_name = nullptr, long long arg = 0) {
+        threads[thread].push_back({name, 'X', start, now() - start, arg_name, arg});
+    }
+
+    void instant(int thread, const char *name, const char *arg_name = nullptr, long long arg = 0) {
+        threads[thread].push_back({name, 'i', now(), 0, arg_name, arg});
+    }
+
+    void write(const std::string &path) const {
+        std::ofstream out(path);
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&]() {
+            out << (first ? "" : ",\n");
+            first = false;
+        };
+        for (std::size_t t = 0; t < threads.size(); t++) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":\""
+                << (t == 0 ? "search" : "worker " + std::to_string(t - 1)) << "\"}}";
+            for (auto &e: threads[t]) {
+                separator();
+                out << "{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << t
+                    << ",\"ts\":" << e.start / 1000.0;
+                if (e.phase == 'X') {
+                    out << ",\"dur\":" << e.duration / 1000.0;
+                }
+                else {
+                    out << ",\"s\":\"t\"";
+                }
+                if (e.arg_name != nullptr) {
+                    out << ",\"args\":{\"" << e.arg_name << "\":" << e.arg << "}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+    }
+};
 
 template<typename Cart=Celeste>
 class SearchelineWorker: public Searcheline<Cart>{
@@ -33,6 +100,11 @@ public:
     const int worker_num;
     std::condition_variable &cv;
     int id;
+    CancellationToken *token = nullptr; // set by ThreadedSearcheline before the search starts
+    // where solutions go, shared by all the workers and only used with var_lock held
+    SolutionSink *shared_sink = nullptr;
+    std::vector<std::vector<int>> *shared_solutions = nullptr;
+    SearchTrace *trace = nullptr; // set if the search is traced
 
     SearchelineWorker(std::mutex& var_lock, std::atomic<int>& waiting_count, std::queue<std::tuple<State, int, std::vector<int>>> &state_queue, int worker_num, std::condition_variable& cv, int id):
         var_lock(var_lock),
@@ -45,17 +117,42 @@ public:
 
     SearchelineWorker(const SearchelineWorker&)=delete;
 
+    // locks var_lock. if the search is traced and another thread holds it, records how long it took to get it
+    std::unique_lock<std::mutex> lock_vars() {
+        if (trace == nullptr) {
+            return std::unique_lock<std::mutex>(var_lock);
+        }
+        std::unique_lock<std::mutex> lk(var_lock, std::try_to_lock);
+        if (!lk.owns_lock()) {
+            long long start = trace->now();
+            lk.lock();
+            trace->complete(id + 1, "lock wait", start);
+        }
+        return lk;
+    }
+
     bool work(){
         while(true){
 
-            std::unique_lock<std::mutex> lk(var_lock);
+            std::unique_lock<std::mutex> lk = lock_vars();
 
             waiting_count++;
             cv.notify_all();
 
-            cv.wait(lk, [this]{return !this->state_queue.empty() || waiting_count==worker_num;});
+            auto ready = [this]{return !this->state_queue.empty() || waiting_count==worker_num || token->stopped();};
+            // only traced when it blocks, so the spans are the real waits
+            if (!ready()) {
+                long long wait_start = trace != nullptr ? trace->now() : 0;
+                cv.wait(lk, ready);
+                if (trace != nullptr) {
+                    trace->complete(id + 1, "cv wait", wait_start);
+                }
+            }
 
-            if(!state_queue.empty()){
+            if(token->stopped()){
+                return ret;
+            }
+            else if(!state_queue.empty()){
                 waiting_count--;
 
                 auto [state, depth, inputs] = std::move(state_queue.front());
@@ -63,14 +160,18 @@ public:
                 // int depth=std::get<1>(state_queue.front());
                 // std::vector<int> inputs=std::get<2>(state_queue.front());
                 state_queue.pop();
+                if (trace != nullptr) {
+                    trace->instant(id + 1, "dequeue", "queued", state_queue.size());
+                }
 
                 lk.unlock();
-                for(auto& obj: state.objects){
-                    obj->p8=std::ref(this->p8);
-                    obj->g=std::ref(this->p8.game());
-                }
+                state.bind(this->p8);
 
+                long long start = trace != nullptr ? trace->now() : 0;
                 ret |= iddfs(state,depth,inputs);
+                if (trace != nullptr) {
+                    trace->complete(id + 1, "subtree", start, "depth", depth);
+                }
             }
             else if(waiting_count==worker_num){
                 return ret;
@@ -78,24 +179,58 @@ public:
         }
     }
 
+    // stops every worker, and wakes up the ones waiting for states
+    void stop(CancellationToken::Reason reason) {
+        {
+            std::lock_guard<std::mutex> lock(var_lock);
+            token->stop(reason);
+        }
+        cv.notify_all();
+    }
+
+    // counts the node, and checks whether the search should stop
+    // the budgets are only looked at every 1024 nodes, which is also how the node limit is shared between workers
+    bool stopped() {
+        if ((++this->nodes & 1023) == 0) {
+            if (token->past_deadline()) {
+                stop(CancellationToken::DEADLINE);
+            }
+            else if (token->spend(1024)) {
+                stop(CancellationToken::NODE_LIMIT);
+            }
+        }
+        return token->stopped();
+    }
+
     bool iddfs(const State &state, int depth, std::vector<int> inputs) {
+        if (stopped()) {
+            return false;
+        }
         if (depth == 0 && this->is_goal(state)) {
-            std::lock_guard<std::mutex> lock(var_lock);
-            this->solutions.push_back(inputs);
-            std::cout << "  inputs: ";
-            for (auto i: inputs) {
-                std::cout << i << ", ";
+            {
+                std::unique_lock<std::mutex> lock = lock_vars();
+                shared_sink->add(inputs, *shared_solutions);
+            }
+            if (token->stop_at_first) {
+                stop(CancellationToken::FIRST_SOLUTION);
             }
-            std::cout << std::endl;
-            std::cout << "  frames: " << inputs.size() - 1 << std::endl;
             return true;
         }
 
         else {
 
             bool optimal_depth = false;
-            if (depth > 0 && this->h_cost(state) <= depth) {
-                for (auto a:this->get_actions(state)) {
+            double h = depth > 0 ? this->h_cost(state) : HUGE_VAL;
+            // this worker's closest node, ThreadedSearcheline keeps the closest of all the workers
+            if (h < this->stats.best_h) {
+                this->stats.best_h = h;
+                this->stats.best_inputs = inputs;
+            }
+            if (h <= depth) {
+                for (auto a: this->from_mask(this->search_actions(state))) {
+                    if (token->stopped()) {
+                        break;
+                    }
 
                     auto [new_state, freeze] = this->transition(state, a);
                     // change: uses current array instead of allocating a new one
@@ -105,7 +240,7 @@ public:
                         inputs.push_back(0);
                     }
 
-                    std::unique_lock<std::mutex> lock(var_lock);
+                    std::unique_lock<std::mutex> lock = lock_vars();
 
                     if(waiting_count==0){
                         lock.unlock();
@@ -118,6 +253,9 @@ public:
                     }
                     else{
                         state_queue.emplace(std::move(new_state),depth-1-freeze,inputs);
+                        if (trace != nullptr) {
+                            trace->instant(id + 1, "enqueue", "queued", state_queue.size());
+                        }
                         lock.unlock();
                         cv.notify_one();
                     }
@@ -138,6 +276,14 @@ class ThreadedSearcheline {
 
 protected:
     int worker_count;
+    std::mutex var_lock;
+    std::condition_variable cv;
+    CancellationToken token;
+    double time_limit = 0;
+    SolutionSink sink;
+    std::string trace_path;
+    SearchTrace trace;
+    bool quiet = false;
 
 public:
     ThreadedSearcheline(int worker_count): worker_count(worker_count){}
@@ -145,25 +291,105 @@ public:
     using objlist=typename workerType::objlist;
     using State=typename workerType::State;
     std::vector<std::vector<int>> solutions;
+    SearchStats stats; // of the last search, partial if it was stopped early
+
+    // stop the running search as soon as possible. safe to call from any thread
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(var_lock);
+            token.stop(CancellationToken::CANCELLED);
+        }
+        cv.notify_all();
+    }
+
+    // end the search at the first solution found, instead of finishing its depth
+    void stop_at_first_solution(bool stop = true) {
+        token.stop_at_first = stop;
+    }
+
+    // only count solutions instead of keeping them, solutions then holds a random sample of sample_size of them
+    void count_solutions(std::size_t sample_size = 0, std::uint64_t seed = 0) {
+        sink.mode = SolutionSink::COUNT;
+        sink.sample_size = sample_size;
+        sink.seed = seed;
+    }
+
+    // write solutions to path as they're found, instead of keeping them. see SolutionSink::read_stream
+    void stream_solutions(const std::string &path) {
+        sink.mode = SolutionSink::STREAM;
+        sink.stream_path = path;
+    }
+
+    // whether to print every solution found
+    void set_verbose(bool verbose) {
+        sink.verbose = verbose;
+    }
+
+    // number of solutions found of each length
+    const std::vector<long long> &solution_counts() const {
+        return sink.counts;
+    }
+
+    // don't print the progress of searches (the depths and times)
+    void set_quiet(bool q = true) {
+        quiet = q;
+    }
+
+    // record when every worker waits on the lock or for states, and takes or queues states, and write it to path
+    // as a chrome trace at the end of the search
+    void enable_trace(const std::string &path) {
+        trace_path = path;
+    }
+
+    // stop the search after this many seconds, 0 for no limit
+    void set_time_limit(double seconds) {
+        time_limit = seconds;
+    }
+
+    // stop the search once the workers expanded about this many nodes in total, 0 for no limit
+    // workers report their nodes 1024 at a time, so it can overshoot by up to 1024 per worker
+    void set_node_limit(long long limit) {
+        token.node_limit = limit;
+    }
+
     std::vector<std::vector<int>> search(int max_depth, bool complete = false) {
         std::vector<std::unique_ptr<workerType>> workers;
 
-        std::mutex var_lock;
         std::atomic<int> waiting_count;
         std::queue<std::tuple<State, int, std::vector<int>>> state_queue;
-        std::condition_variable cv;
 
         for(int i=0; i<worker_count; i++){
             workers.emplace_back(std::make_unique<workerType>(var_lock, waiting_count, state_queue, worker_count,cv,i));
             workers[i]->init_state();
+            workers[i]->token = &token;
+            workers[i]->shared_sink = &sink;
+            workers[i]->shared_solutions = &solutions;
+            workers[i]->trace = trace_path.empty() ? nullptr : &trace;
+        }
+        if (!trace_path.empty()) {
+            trace.reset(worker_count + 1);
         }
+        solutions.clear();
+        sink.reset();
+        sink.open();
         State state(workers[0]->p8);
 
         auto t1 = std::chrono::high_resolution_clock::now();
-        std::cout << "searching..." << std::endl;
+        stats = SearchStats();
+        token.reset();
+        token.deadline = time_limit > 0 ?
+                         std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_limit)) :
+                         std::chrono::steady_clock::time_point::max();
+        if (!quiet) {
+            std::cout << "searching..." << std::endl;
+        }
 
         for (int depth = 0; depth <= max_depth; depth++) {
-            std::cout << "depth " << depth << "..." << std::endl;
+            if (!quiet) {
+                std::cout << "depth " << depth << "..." << std::endl;
+            }
+            stats.depth = depth;
+            long long depth_start = trace.now();
             std::vector<int> inputs;
 
             std::vector<std::thread> threads;
@@ -177,27 +403,68 @@ public:
 
 
 
+            long long join_start = trace.now();
             for(auto &t: threads){
                 t.join();
             }
+            if (!trace_path.empty()) {
+                // the barrier between depths
+                trace.complete(0, "join", join_start, "depth", depth);
+                trace.complete(0, "depth", depth_start, "depth", depth);
+            }
 
             bool done = false;
             for (auto &w: workers){
                 if(w->ret){
                     done=true;
                 }
-                this->solutions.insert(this->solutions.end(),w->solutions.begin(),w->solutions.end());
             }
-            done = done && !complete;
+            done = done && (!complete || token.stop_at_first);
 
-            auto t2 = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> elapsed_time = t2 - t1;
-            std::cout << "  elapsed time: " << std::fixed << std::setprecision(2) << (elapsed_time.count()) << " [s]"
-                      << std::endl;
+            if (!quiet) {
+                if (sink.mode != SolutionSink::STORE && depth < (int) sink.counts.size() && sink.counts[depth] > 0) {
+                    std::cout << "  solutions: " << sink.counts[depth] << std::endl;
+                }
+                auto t2 = std::chrono::high_resolution_clock::now();
+                std::chrono::duration<double> elapsed_time = t2 - t1;
+                std::cout << "  elapsed time: " << std::fixed << std::setprecision(2) << (elapsed_time.count())
+                          << " [s]" << std::endl;
+            }
+            if (token.stopped()) {
+                // states the workers didn't get to
+                state_queue = std::queue<std::tuple<State, int, std::vector<int>>>();
+                if (!quiet && token.reason() == CancellationToken::CANCELLED) {
+                    std::cout << "  cancelled" << std::endl;
+                }
+                else if (!quiet && token.reason() == CancellationToken::DEADLINE) {
+                    std::cout << "  time limit reached" << std::endl;
+                }
+                else if (!quiet && token.reason() == CancellationToken::NODE_LIMIT) {
+                    std::cout << "  node limit reached" << std::endl;
+                }
+                break;
+            }
+            stats.completed_depth = depth;
             if (done) {
                 break;
             }
         }
+        for (auto &w: workers) {
+            stats.nodes += w->nodes;
+            if (w->stats.best_h < stats.best_h) {
+                stats.best_h = w->stats.best_h;
+                stats.best_inputs = w->stats.best_inputs;
+            }
+        }
+        stats.solution_count = sink.total;
+        if (sink.mode == SolutionSink::STREAM) {
+            sink.stream.close();
+        }
+        stats.stop_reason = token.reason();
+        stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t1).count();
+        if (!trace_path.empty()) {
+            trace.write(trace_path);
+        }
         return this->solutions;
     }
 };